@@ -0,0 +1,399 @@
+#include "AsyncLogSource.hpp"
+#include <deque>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef AGGREGATOR_HAS_LIBURING
+#include <liburing.h>
+#endif
+
+using namespace aggregator;
+
+static const size_t BLOCK_ALIGNMENT = 4096;
+
+struct AsyncFileReader::Block
+{
+    uint8_t *buffer;
+    uint64_t offset;
+    size_t length;
+    int error;
+    bool submitted;
+    bool ready;
+};
+
+class AsyncFileReader::Backend
+{
+public:
+    virtual ~Backend() {}
+    virtual bool usesIoUring() const = 0;
+    /** starts the read of the given block */
+    virtual void submit( Block &block ) = 0;
+    /** waits for the read of the given block to finish */
+    virtual void wait( Block &block ) = 0;
+};
+
+namespace
+{
+    typedef AsyncFileReader::Block Block;
+
+    /** reads size bytes at offset, stopping only at the end of the file
+     *
+     * buffer, size and offset must be aligned on BLOCK_ALIGNMENT. A short
+     * read is continued from the start of its last partial page, so that
+     * all reads stay aligned, as required by O_DIRECT.
+     *
+     * @result - the count of bytes read, or -errno
+     */
+    ssize_t readFully( int fd, uint8_t *buffer, size_t size, uint64_t offset, uint64_t file_size )
+    {
+	size_t end = offset < file_size ? std::min<uint64_t>( size, file_size - offset ) : 0;
+	size_t done = 0;
+	while( done < end )
+	{
+	    ssize_t ret = pread( fd, buffer + done, size - done, offset + done );
+	    if( ret < 0 && errno == EINTR )
+		continue;
+	    else if( ret < 0 )
+		return -errno;
+	    else if( ret == 0 )
+		break;
+
+	    size_t next = done + ret;
+	    if( next < end && next % BLOCK_ALIGNMENT != 0 )
+	    {
+		// read the partial page again, unless that makes no progress
+		size_t aligned = next - next % BLOCK_ALIGNMENT;
+		if( aligned > done )
+		    next = aligned;
+	    }
+	    done = next;
+	}
+	return done;
+    }
+
+    /** sets the length or the error of a block given the result of its
+     * read. Short reads before the end of the file are completed
+     * synchronously, from the last aligned offset.
+     *
+     * The caller marks the block as ready afterwards */
+    void completeBlock( int fd, uint64_t file_size, size_t block_size, Block &block, ssize_t result )
+    {
+	if( result >= 0 && static_cast<size_t>( result ) < block_size
+		&& block.offset + result < file_size )
+	{
+	    size_t aligned = result - result % BLOCK_ALIGNMENT;
+	    ssize_t rest = readFully( fd, block.buffer + aligned, block_size - aligned, block.offset + aligned, file_size );
+	    result = rest < 0 ? rest : aligned + rest;
+	}
+
+	if( result < 0 )
+	{
+	    block.error = -result;
+	    block.length = 0;
+	}
+	else
+	{
+	    block.error = 0;
+	    block.length = result;
+	}
+    }
+
+    class ThreadPoolBackend : public AsyncFileReader::Backend
+    {
+	int fd;
+	uint64_t file_size;
+	size_t block_size;
+	pthread_mutex_t mutex;
+	pthread_cond_t submitted;
+	pthread_cond_t completed;
+	std::deque<Block*> pending;
+	std::vector<pthread_t> threads;
+	bool quit;
+
+	static void* run( void *self )
+	{
+	    static_cast<ThreadPoolBackend*>( self )->work();
+	    return 0;
+	}
+
+	void work()
+	{
+	    pthread_mutex_lock( &mutex );
+	    while( true )
+	    {
+		while( pending.empty() && !quit )
+		    pthread_cond_wait( &submitted, &mutex );
+		if( quit )
+		    break;
+
+		Block *block = pending.front();
+		pending.pop_front();
+		pthread_mutex_unlock( &mutex );
+
+		ssize_t result = readFully( fd, block->buffer, block_size, block->offset, file_size );
+		completeBlock( fd, file_size, block_size, *block, result );
+
+		pthread_mutex_lock( &mutex );
+		block->ready = true;
+		pthread_cond_broadcast( &completed );
+	    }
+	    pthread_mutex_unlock( &mutex );
+	}
+
+    public:
+	ThreadPoolBackend( int fd, uint64_t file_size, size_t block_size, size_t thread_count )
+	    : fd( fd ), file_size( file_size ), block_size( block_size ), quit( false )
+	{
+	    pthread_mutex_init( &mutex, 0 );
+	    pthread_cond_init( &submitted, 0 );
+	    pthread_cond_init( &completed, 0 );
+	    for( size_t i = 0; i < std::max<size_t>( thread_count, 1 ); ++i )
+	    {
+		pthread_t thread;
+		if( pthread_create( &thread, 0, &ThreadPoolBackend::run, this ) != 0 )
+		    break;
+		threads.push_back( thread );
+	    }
+
+	    if( threads.empty() )
+	    {
+		pthread_cond_destroy( &completed );
+		pthread_cond_destroy( &submitted );
+		pthread_mutex_destroy( &mutex );
+		throw std::runtime_error("AsyncFileReader: cannot start the reading threads.");
+	    }
+	}
+
+	~ThreadPoolBackend()
+	{
+	    pthread_mutex_lock( &mutex );
+	    quit = true;
+	    pthread_cond_broadcast( &submitted );
+	    pthread_mutex_unlock( &mutex );
+	    for( size_t i = 0; i < threads.size(); ++i )
+		pthread_join( threads[i], 0 );
+
+	    pthread_cond_destroy( &completed );
+	    pthread_cond_destroy( &submitted );
+	    pthread_mutex_destroy( &mutex );
+	}
+
+	bool usesIoUring() const { return false; }
+
+	void submit( Block &block )
+	{
+	    pthread_mutex_lock( &mutex );
+	    block.ready = false;
+	    pending.push_back( &block );
+	    pthread_cond_signal( &submitted );
+	    pthread_mutex_unlock( &mutex );
+	}
+
+	void wait( Block &block )
+	{
+	    pthread_mutex_lock( &mutex );
+	    while( !block.ready )
+		pthread_cond_wait( &completed, &mutex );
+	    pthread_mutex_unlock( &mutex );
+	}
+    };
+
+#ifdef AGGREGATOR_HAS_LIBURING
+    class IoUringBackend : public AsyncFileReader::Backend
+    {
+	int fd;
+	uint64_t file_size;
+	size_t block_size;
+	struct io_uring ring;
+
+    public:
+	IoUringBackend( int fd, uint64_t file_size, size_t block_size, size_t queue_depth )
+	    : fd( fd ), file_size( file_size ), block_size( block_size )
+	{
+	    int ret = io_uring_queue_init( queue_depth, &ring, 0 );
+	    if( ret < 0 )
+		throw std::runtime_error(std::string("AsyncFileReader: cannot create the io_uring: ") + strerror(-ret));
+	}
+
+	~IoUringBackend()
+	{
+	    io_uring_queue_exit( &ring );
+	}
+
+	bool usesIoUring() const { return true; }
+
+	void submit( Block &block )
+	{
+	    block.ready = false;
+	    struct io_uring_sqe *sqe = io_uring_get_sqe( &ring );
+	    if( !sqe )
+		throw std::runtime_error("AsyncFileReader: the io_uring submission queue is full.");
+	    io_uring_prep_read( sqe, fd, block.buffer, block_size, block.offset );
+	    io_uring_sqe_set_data( sqe, &block );
+
+	    int ret = io_uring_submit( &ring );
+	    if( ret < 0 )
+		throw std::runtime_error(std::string("AsyncFileReader: io_uring submission failed: ") + strerror(-ret));
+	}
+
+	void wait( Block &block )
+	{
+	    while( !block.ready )
+	    {
+		struct io_uring_cqe *cqe = 0;
+		int ret = io_uring_wait_cqe( &ring, &cqe );
+		if( ret == -EINTR )
+		    continue;
+		else if( ret < 0 )
+		    throw std::runtime_error(std::string("AsyncFileReader: io_uring wait failed: ") + strerror(-ret));
+
+		Block *done = static_cast<Block*>( io_uring_cqe_get_data( cqe ) );
+		ssize_t result = cqe->res;
+		io_uring_cqe_seen( &ring, cqe );
+		completeBlock( fd, file_size, block_size, *done, result );
+		done->ready = true;
+	    }
+	}
+    };
+#endif
+}
+
+AsyncFileReader::AsyncFileReader( const std::string &path, const Config &config )
+    : config( config ), fd( -1 ), file_size( 0 ), next_offset( 0 ),
+      blocks( 0 ), current( 0 ), handed_out( false ), backend( 0 )
+{
+    if( config.block_size == 0 || config.block_size % BLOCK_ALIGNMENT != 0 )
+	throw std::runtime_error("AsyncFileReader: the block size must be a non-zero multiple of 4096.");
+    if( config.queue_depth == 0 )
+	throw std::runtime_error("AsyncFileReader: the queue depth must not be zero.");
+
+#ifdef O_DIRECT
+    if( config.direct )
+	fd = open( path.c_str(), O_RDONLY | O_DIRECT );
+#endif
+    if( fd < 0 )
+	fd = open( path.c_str(), O_RDONLY );
+    if( fd < 0 )
+	throw std::runtime_error(std::string("AsyncFileReader: cannot open ") + path + ": " + strerror(errno));
+
+    struct stat info;
+    if( fstat( fd, &info ) != 0 )
+    {
+	close( fd );
+	throw std::runtime_error(std::string("AsyncFileReader: cannot stat ") + path + ": " + strerror(errno));
+    }
+    file_size = info.st_size;
+
+#ifdef AGGREGATOR_HAS_LIBURING
+    if( config.use_io_uring )
+    {
+	try { backend = new IoUringBackend( fd, file_size, config.block_size, config.queue_depth ); }
+	catch( std::runtime_error& ) {}
+    }
+#endif
+    try
+    {
+	if( !backend )
+	    backend = new ThreadPoolBackend( fd, file_size, config.block_size, config.threads );
+    }
+    catch( ... )
+    {
+	close( fd );
+	throw;
+    }
+
+    try { blocks = new Block[config.queue_depth]; }
+    catch( ... )
+    {
+	delete backend;
+	close( fd );
+	throw;
+    }
+    for( size_t i = 0; i < config.queue_depth; ++i )
+    {
+	void *buffer = 0;
+	if( posix_memalign( &buffer, BLOCK_ALIGNMENT, config.block_size ) != 0 )
+	{
+	    for( size_t j = 0; j < i; ++j )
+		free( blocks[j].buffer );
+	    delete[] blocks;
+	    delete backend;
+	    close( fd );
+	    throw std::bad_alloc();
+	}
+	blocks[i].buffer = static_cast<uint8_t*>( buffer );
+	blocks[i].submitted = false;
+	blocks[i].ready = false;
+    }
+
+    for( size_t i = 0; i < config.queue_depth; ++i )
+	submit( blocks[i] );
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+    // the reads in flight write into the blocks, wait for them before
+    // releasing the memory
+    for( size_t i = 0; i < config.queue_depth; ++i )
+    {
+	if( blocks[i].submitted )
+	{
+	    try { backend->wait( blocks[i] ); }
+	    catch( std::runtime_error& ) {}
+	}
+    }
+    delete backend;
+
+    for( size_t i = 0; i < config.queue_depth; ++i )
+	free( blocks[i].buffer );
+    delete[] blocks;
+    close( fd );
+}
+
+bool AsyncFileReader::usesIoUring() const
+{
+    return backend->usesIoUring();
+}
+
+void AsyncFileReader::submit( Block &block )
+{
+    if( next_offset >= file_size )
+    {
+	block.submitted = false;
+	return;
+    }
+
+    block.offset = next_offset;
+    block.submitted = true;
+    next_offset += config.block_size;
+    backend->submit( block );
+}
+
+ByteSpan AsyncFileReader::next()
+{
+    if( handed_out )
+    {
+	// the consumer is done with the previous block, reuse it for the next
+	// read
+	Block &done = blocks[current];
+	done.submitted = false;
+	submit( done );
+	current = (current + 1) % config.queue_depth;
+	handed_out = false;
+    }
+
+    Block &block = blocks[current];
+    if( !block.submitted )
+	return ByteSpan();
+
+    backend->wait( block );
+    if( block.error )
+	throw std::runtime_error(std::string("AsyncFileReader: read failed: ") + strerror(block.error));
+
+    handed_out = true;
+    return ByteSpan( block.buffer, block.length );
+}
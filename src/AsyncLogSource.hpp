@@ -0,0 +1,197 @@
+#ifndef __AGGREGATOR_ASYNCLOGSOURCE_HPP__
+#define __AGGREGATOR_ASYNCLOGSOURCE_HPP__
+
+#include <base/Time.hpp>
+#include <boost/function.hpp>
+#include <aggregator/ByteRingBuffer.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace aggregator
+{
+    /** Reads a file sequentially, keeping a fixed number of large reads in
+     * flight ahead of the consumer.
+     *
+     * The reads are done with io_uring if the library has been built with
+     * liburing and the kernel supports it, and by a small pool of threads
+     * otherwise. The memory used is queue_depth * block_size, regardless of
+     * the file size.
+     */
+    class AsyncFileReader
+    {
+    public:
+	struct Config
+	{
+	    /** size of a single read, in bytes. Must be a multiple of 4096 */
+	    size_t block_size;
+	    /** count of reads in flight */
+	    size_t queue_depth;
+	    /** count of reading threads if io_uring is not used */
+	    size_t threads;
+	    /** use io_uring if available */
+	    bool use_io_uring;
+	    /** open the file with O_DIRECT, bypassing the page cache. Ignored
+	     * if the filesystem does not support it */
+	    bool direct;
+
+	    Config()
+		: block_size( 1 << 20 ), queue_depth( 8 ), threads( 2 ),
+		  use_io_uring( true ), direct( false ) {}
+	};
+
+	struct Block;
+	class Backend;
+
+	explicit AsyncFileReader( const std::string &path, const Config &config = Config() );
+	~AsyncFileReader();
+
+	/** returns the next block of the file, waiting for its read to
+	 * finish if needed. The data stays valid until the next call.
+	 *
+	 * @result - the block data, empty at the end of the file. Throws if
+	 *           the read failed.
+	 */
+	ByteSpan next();
+
+	/** size of the file at the time it got opened */
+	uint64_t fileSize() const { return file_size; }
+
+	/** true if the reads go through io_uring, false if they are done by
+	 * the thread pool */
+	bool usesIoUring() const;
+
+    private:
+	AsyncFileReader( const AsyncFileReader& );
+	AsyncFileReader& operator=( const AsyncFileReader& );
+
+	void submit( Block &block );
+
+	Config config;
+	int fd;
+	uint64_t file_size;
+	uint64_t next_offset;
+	Block *blocks;
+	size_t current;
+	bool handed_out;
+	Backend *backend;
+    };
+
+    /** Source of samples decoded from a log file, meant to be used as the
+     * pull callback of a PullStreamAligner stream:
+     *
+     * <code>
+     * AsyncLogSource<Sample> source( path, &decodeSample, 4096 );
+     * aligner.registerStream<Sample>(
+     *	    boost::bind( &AsyncLogSource<Sample>::pull, &source, _1, _2 ),
+     *	    callback, buffer_size, period );
+     * </code>
+     *
+     * Records are decoded in place from the blocks of an AsyncFileReader.
+     * Records that span two blocks are reassembled in a buffer of at most
+     * max_record_size bytes.
+     */
+    template <class T>
+    class AsyncLogSource
+    {
+    public:
+	/** decodes one record from the beginning of data
+	 *
+	 * @result - the count of bytes used by the record, or zero if data
+	 *           does not hold a complete record
+	 */
+	typedef boost::function<size_t (const ByteSpan&, base::Time&, T&)> decode_callback_t;
+
+	AsyncLogSource( const std::string &path, decode_callback_t decode, size_t max_record_size,
+		const AsyncFileReader::Config &config = AsyncFileReader::Config() )
+	    : reader( path, config ), decode( decode ), max_record_size( max_record_size ),
+	      record_count( 0 )
+	{
+	    carry.reserve( max_record_size );
+	}
+
+	/** decodes the next record
+	 *
+	 * @result - false at the end of the file. A truncated last record is
+	 *           ignored.
+	 */
+	bool pull( base::Time &time, T &sample )
+	{
+	    while( true )
+	    {
+		if( block.empty() )
+		{
+		    block = reader.next();
+		    if( block.empty() )
+		    {
+			carry.clear();
+			return false;
+		    }
+		}
+
+		if( carry.empty() )
+		{
+		    size_t used = decode( block, time, sample );
+		    if( used )
+		    {
+			block = ByteSpan( block.begin() + used, block.size() - used );
+			record_count++;
+			return true;
+		    }
+
+		    // the record continues in the next block
+		    if( block.size() > max_record_size )
+			throw std::runtime_error("AsyncLogSource: record is larger than max_record_size.");
+		    carry.assign( block.begin(), block.end() );
+		    block = ByteSpan();
+		    continue;
+		}
+
+		size_t previous = carry.size();
+		size_t take = std::min( block.size(), max_record_size - previous );
+		carry.insert( carry.end(), block.begin(), block.begin() + take );
+		size_t used = decode( ByteSpan( &carry[0], carry.size() ), time, sample );
+		if( !used )
+		{
+		    if( take < block.size() )
+			throw std::runtime_error("AsyncLogSource: record is larger than max_record_size.");
+		    block = ByteSpan();
+		    continue;
+		}
+
+		if( used >= previous )
+		{
+		    block = ByteSpan( block.begin() + (used - previous), block.size() - (used - previous) );
+		    carry.clear();
+		}
+		else
+		{
+		    // the record was complete before the new data, keep the
+		    // rest of the carried bytes for the next record
+		    carry.resize( previous );
+		    carry.erase( carry.begin(), carry.begin() + used );
+		}
+		record_count++;
+		return true;
+	    }
+	}
+
+	/** count of records decoded so far */
+	size_t getRecordCount() const { return record_count; }
+
+	const AsyncFileReader& getReader() const { return reader; }
+
+    private:
+	AsyncFileReader reader;
+	decode_callback_t decode;
+	size_t max_record_size;
+	/** remaining data of the current block */
+	ByteSpan block;
+	/** beginning of a record that spans two blocks */
+	std::vector<uint8_t> carry;
+	size_t record_count;
+    };
+}
+
+#endif
@@ -0,0 +1,151 @@
+#include "ByteRingBuffer.hpp"
+#include <string.h>
+#include <stdexcept>
+
+using namespace aggregator;
+
+const uint64_t ByteRingBuffer::WRAP;
+const size_t ByteRingBuffer::ALIGNMENT;
+
+ByteRingBuffer::ByteRingBuffer( size_t capacity, MemoryResource *resource )
+    : resource( resource ? resource : getDefaultMemoryResource() ),
+      memory( 0 ), memory_size( (capacity + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT ),
+      head( 0 ), tail( 0 ), packet_count( 0 )
+{
+    if( memory_size < recordSize(0) )
+	throw std::runtime_error("ByteRingBuffer: capacity is too small to hold a single packet.");
+    memory = static_cast<uint8_t*>( this->resource->allocate( memory_size, ALIGNMENT ) );
+}
+
+ByteRingBuffer::~ByteRingBuffer()
+{
+    resource->deallocate( memory, memory_size, ALIGNMENT );
+}
+
+ByteRingBuffer& ByteRingBuffer::operator=( const ByteRingBuffer &other )
+{
+    if( this == &other )
+	return *this;
+
+    if( memory_size != other.memory_size )
+    {
+	uint8_t *new_memory = static_cast<uint8_t*>( resource->allocate( other.memory_size, ALIGNMENT ) );
+	resource->deallocate( memory, memory_size, ALIGNMENT );
+	memory = new_memory;
+	memory_size = other.memory_size;
+    }
+
+    memcpy( memory, other.memory, memory_size );
+    head = other.head;
+    tail = other.tail;
+    packet_count = other.packet_count;
+    return *this;
+}
+
+size_t ByteRingBuffer::recordSize( size_t size )
+{
+    return sizeof(Header) + (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+ByteRingBuffer::Header ByteRingBuffer::readHeader( uint64_t pos ) const
+{
+    Header header;
+    memcpy( &header, memory + pos % memory_size, sizeof(Header) );
+    return header;
+}
+
+uint64_t ByteRingBuffer::resolve( uint64_t pos ) const
+{
+    size_t left = memory_size - pos % memory_size;
+    if( left < sizeof(Header) || readHeader( pos ).size == WRAP )
+	return pos + left;
+    return pos;
+}
+
+bool ByteRingBuffer::fits( size_t size ) const
+{
+    return recordSize( size ) <= memory_size;
+}
+
+size_t ByteRingBuffer::push( const base::Time &time, const uint8_t *data, size_t size )
+{
+    if( !fits( size ) )
+	throw std::runtime_error("ByteRingBuffer: packet is larger than the buffer.");
+
+    size_t record = recordSize( size );
+    size_t left = memory_size - tail % memory_size;
+    size_t needed = record;
+    if( left < record )
+	needed += left;
+
+    size_t dropped = 0;
+    while( !empty() && memory_size - (tail - head) < needed )
+    {
+	pop();
+	dropped++;
+    }
+
+    if( empty() && left < record )
+    {
+	// start over at the beginning of the ring
+	tail += left;
+	head = tail;
+	left = memory_size;
+    }
+
+    if( left < record )
+    {
+	if( left >= sizeof(Header) )
+	{
+	    Header wrap;
+	    wrap.size = WRAP;
+	    memcpy( memory + tail % memory_size, &wrap, sizeof(Header) );
+	}
+	tail += left;
+    }
+
+    Header header;
+    header.time = time;
+    header.size = size;
+    uint8_t *ptr = memory + tail % memory_size;
+    memcpy( ptr, &header, sizeof(Header) );
+    if( size )
+	memcpy( ptr + sizeof(Header), data, size );
+    tail += record;
+    packet_count++;
+    return dropped;
+}
+
+void ByteRingBuffer::pop()
+{
+    if( empty() )
+	throw std::runtime_error("ByteRingBuffer: pop() called on an empty buffer.");
+
+    head = next( head );
+    packet_count--;
+    if( empty() )
+	head = tail;
+}
+
+void ByteRingBuffer::clear()
+{
+    head = tail;
+    packet_count = 0;
+}
+
+base::Time ByteRingBuffer::time( uint64_t pos ) const
+{
+    return readHeader( resolve( pos ) ).time;
+}
+
+ByteSpan ByteRingBuffer::data( uint64_t pos ) const
+{
+    pos = resolve( pos );
+    return ByteSpan( memory + pos % memory_size + sizeof(Header), readHeader( pos ).size );
+}
+
+uint64_t ByteRingBuffer::next( uint64_t pos ) const
+{
+    pos = resolve( pos );
+    return pos + recordSize( readHeader( pos ).size );
+}
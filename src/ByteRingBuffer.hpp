@@ -0,0 +1,120 @@
+#ifndef __AGGREGATOR_BYTERINGBUFFER_HPP__
+#define __AGGREGATOR_BYTERINGBUFFER_HPP__
+
+#include <base/Time.hpp>
+#include <stdint.h>
+#include <aggregator/MemoryResource.hpp>
+
+namespace aggregator
+{
+    /** Read-only view on a contiguous range of bytes */
+    struct ByteSpan
+    {
+	const uint8_t *ptr;
+	size_t length;
+
+	ByteSpan() : ptr( 0 ), length( 0 ) {}
+	ByteSpan( const uint8_t *ptr, size_t length ) : ptr( ptr ), length( length ) {}
+
+	const uint8_t* data() const { return ptr; }
+	size_t size() const { return length; }
+	bool empty() const { return length == 0; }
+	const uint8_t* begin() const { return ptr; }
+	const uint8_t* end() const { return ptr + length; }
+	uint8_t operator[]( size_t i ) const { return ptr[i]; }
+    };
+
+    /** FIFO of timestamped variable-length packets, stored contiguously in
+     * a fixed-size byte ring.
+     *
+     * Each packet is stored as a small header holding its timestamp and its
+     * length, directly followed by the payload. Packets never wrap around
+     * the end of the ring, so that their payload can always be accessed as
+     * a single ByteSpan. The space left at the end of the ring when a packet
+     * does not fit there is skipped.
+     *
+     * Packets are addressed by their position, which increases
+     * monotonically over the life of the buffer. Positions stay valid until
+     * the packet is removed, and can therefore be used as read cursors.
+     */
+    class ByteRingBuffer
+    {
+	struct Header
+	{
+	    base::Time time;
+	    uint64_t size;
+	};
+
+	/** header size value that marks the end of the used part of the ring */
+	static const uint64_t WRAP = ~uint64_t(0);
+	static const size_t ALIGNMENT = 8;
+
+	MemoryResource *resource;
+	uint8_t *memory;
+	size_t memory_size;
+	uint64_t head;
+	uint64_t tail;
+	size_t packet_count;
+
+	/** @return the position of the packet stored at pos, skipping the
+	 * unused space at the end of the ring */
+	uint64_t resolve( uint64_t pos ) const;
+	Header readHeader( uint64_t pos ) const;
+	static size_t recordSize( size_t size );
+
+	ByteRingBuffer( const ByteRingBuffer& );
+
+    public:
+	/** @param capacity - size of the ring in bytes
+	 * @param resource - memory resource of the ring. The default one is
+	 *      used if it is null
+	 */
+	explicit ByteRingBuffer( size_t capacity, MemoryResource *resource = 0 );
+	~ByteRingBuffer();
+
+	/** copies the content of other into this buffer, reallocating it if the
+	 * capacities differ
+	 */
+	ByteRingBuffer& operator=( const ByteRingBuffer &other );
+
+	/** The size of the ring in bytes */
+	size_t capacity() const { return memory_size; }
+	/** The count of bytes used by the stored packets, including their
+	 * headers */
+	size_t size() const { return tail - head; }
+	/** The count of stored packets */
+	size_t count() const { return packet_count; }
+	bool empty() const { return packet_count == 0; }
+
+	/** Position of the oldest packet */
+	uint64_t begin() const { return head; }
+	/** Position after the newest packet */
+	uint64_t end() const { return tail; }
+
+	/** @return true if a packet of the given size can be stored at all */
+	bool fits( size_t size ) const;
+
+	/** Appends a packet, removing the oldest packets if there is not
+	 * enough space left.
+	 *
+	 * @return the count of packets that have been removed. Throws if the
+	 *   packet is larger than the ring.
+	 */
+	size_t push( const base::Time &time, const uint8_t *data, size_t size );
+
+	/** Removes the oldest packet */
+	void pop();
+
+	/** Removes all packets */
+	void clear();
+
+	/** The timestamp of the packet at the given position */
+	base::Time time( uint64_t pos ) const;
+	/** The payload of the packet at the given position */
+	ByteSpan data( uint64_t pos ) const;
+	/** The position of the packet following the one at pos */
+	uint64_t next( uint64_t pos ) const;
+    };
+}
+
+#endif
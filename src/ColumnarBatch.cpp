@@ -0,0 +1,74 @@
+#include "ColumnarBatch.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace aggregator;
+
+ColumnarBatchBuilder::ColumnarBatchBuilder( size_t batch_size, batch_callback_t callback )
+    : batch_size( batch_size ), callback( callback ), sequence( 0 )
+{
+    if( batch_size == 0 )
+	throw std::runtime_error("ColumnarBatchBuilder: the batch size must not be zero.");
+}
+
+size_t ColumnarBatchBuilder::addTable( const std::string &name, const std::vector<std::string> &columns )
+{
+    ColumnarBatch::Table table;
+    table.name = name;
+    table.column_names = columns;
+    table.columns.resize( columns.size() );
+    batch.tables.push_back( table );
+
+    // a single stream may fill a whole batch. The reservation is redone on
+    // all tables, as growing the table list may copy them without their
+    // capacity
+    for( size_t i = 0; i < batch.tables.size(); ++i )
+    {
+	ColumnarBatch::Table &t( batch.tables[i] );
+	t.times.reserve( batch_size );
+	t.sequence.reserve( batch_size );
+	for( size_t j = 0; j < t.columns.size(); ++j )
+	    t.columns[j].reserve( batch_size );
+    }
+
+    if( row.size() < columns.size() )
+	row.resize( columns.size() );
+    return batch.tables.size() - 1;
+}
+
+double* ColumnarBatchBuilder::beginRow( size_t table, const base::Time &ts )
+{
+    ColumnarBatch::Table &t( batch.tables[table] );
+    t.times.push_back( ts );
+    t.sequence.push_back( sequence++ );
+    std::fill( row.begin(), row.end(), 0.0 );
+    return row.empty() ? 0 : &row[0];
+}
+
+void ColumnarBatchBuilder::endRow( size_t table )
+{
+    ColumnarBatch::Table &t( batch.tables[table] );
+    for( size_t i = 0; i < t.columns.size(); ++i )
+	t.columns[i].push_back( row[i] );
+
+    if( ++batch.samples >= batch_size )
+	flush();
+}
+
+void ColumnarBatchBuilder::flush()
+{
+    if( batch.empty() )
+	return;
+
+    callback( batch );
+
+    for( size_t i = 0; i < batch.tables.size(); ++i )
+    {
+	ColumnarBatch::Table &t( batch.tables[i] );
+	t.times.clear();
+	t.sequence.clear();
+	for( size_t j = 0; j < t.columns.size(); ++j )
+	    t.columns[j].clear();
+    }
+    batch.samples = 0;
+}
@@ -0,0 +1,144 @@
+#ifndef __AGGREGATOR_COLUMNARBATCH_HPP__
+#define __AGGREGATOR_COLUMNARBATCH_HPP__
+
+#include <base/Time.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+
+namespace aggregator
+{
+    /** Merged samples of a stream aligner, stored column by column.
+     *
+     * There is one table per stream. Each table holds the timestamps of the
+     * samples, their position in the merged output and one column per
+     * field, so that all values of a field are contiguous.
+     */
+    struct ColumnarBatch
+    {
+	struct Table
+	{
+	    /** name of the table, given to ColumnarBatchBuilder::addStream() */
+	    std::string name;
+	    /** names of the columns */
+	    std::vector<std::string> column_names;
+	    /** timestamps of the samples */
+	    std::vector<base::Time> times;
+	    /** position of the samples in the merged output, counted from the
+	     * creation of the builder. Merging the tables on this column
+	     * gives back the order of the stream aligner */
+	    std::vector<uint64_t> sequence;
+	    /** values of the fields, indexed by column then by sample. Fields
+	     * that the extractor does not write are zero */
+	    std::vector< std::vector<double> > columns;
+
+	    size_t size() const { return times.size(); }
+	};
+
+	/** tables in the order in which their streams were added */
+	std::vector<Table> tables;
+	/** total count of samples in the tables */
+	size_t samples;
+
+	ColumnarBatch() : samples(0) {}
+	size_t size() const { return samples; }
+	bool empty() const { return samples == 0; }
+    };
+
+    /** Collects the output of a stream aligner into columnar batches.
+     *
+     * Each stream is added with a hook that extracts the fields of a sample,
+     * and the callback returned by addStream() is registered as the stream
+     * callback:
+     *
+     * \code
+     * ColumnarBatchBuilder builder( 4096, &process_batch );
+     * aligner.registerStream<Imu>( builder.addStream<Imu>( "imu", columns, &extract_imu ), 16, period );
+     * while( aligner.step() );
+     * builder.flush();
+     * \endcode
+     *
+     * The builder sits on the user side of the stream aligner: the aligner
+     * still calls one stream callback per sample, and the builder turns these
+     * calls into one batch callback per batch_size samples. It saves the
+     * per-sample work of the consumer, not the dispatch inside the aligner.
+     *
+     * Once a batch holds batch_size samples, it is given to the batch
+     * callback and emptied. addStream() reserves batch_size samples in each
+     * column of the table, and the memory is kept from one batch to the
+     * next, so that the builder does not allocate while collecting samples.
+     *
+     * The callbacks returned by addStream() refer to the builder, which must
+     * therefore not be copied or destroyed while they are in use.
+     */
+    class ColumnarBatchBuilder
+    {
+    public:
+	typedef boost::function<void (const ColumnarBatch &batch)> batch_callback_t;
+
+	template <class T> struct field_extractor
+	{
+	    /** writes the fields of a sample into row, one value per column */
+	    typedef boost::function<void (const T &sample, double *row)> type;
+	};
+
+	/** @param batch_size - count of samples after which a batch is given
+	 *      to the callback
+	 * @param callback - called with each complete batch
+	 */
+	ColumnarBatchBuilder( size_t batch_size, batch_callback_t callback );
+
+	/** Adds a table for a stream
+	 *
+	 * @param name - name of the table
+	 * @param columns - names of the fields written by the extractor
+	 * @param extractor - writes the fields of a sample
+	 * @result - the callback to register for the stream
+	 */
+	template <class T>
+	boost::function<void (const base::Time &ts, const T &value)> addStream( const std::string &name,
+		const std::vector<std::string> &columns, typename field_extractor<T>::type extractor )
+	{
+	    size_t table = addTable( name, columns );
+	    return boost::bind( &ColumnarBatchBuilder::appendSample<T>, this, table, extractor, _1, _2 );
+	}
+
+	/** Gives the samples collected so far to the batch callback, if
+	 * there are any. It should be called once the stream aligner is
+	 * done, the builder does not flush on destruction */
+	void flush();
+
+	/** Count of samples added since the creation of the builder */
+	uint64_t getSampleCount() const { return sequence; }
+
+	/** The batch being filled */
+	const ColumnarBatch& getBatch() const { return batch; }
+
+    private:
+	size_t addTable( const std::string &name, const std::vector<std::string> &columns );
+	/** appends the time and the sequence number of a sample, and returns
+	 * the row into which the fields are extracted */
+	double* beginRow( size_t table, const base::Time &ts );
+	/** copies the extracted row into the columns */
+	void endRow( size_t table );
+
+	template <class T>
+	void appendSample( size_t table, const typename field_extractor<T>::type &extractor, const base::Time &ts, const T &value )
+	{
+	    extractor( value, beginRow( table, ts ) );
+	    endRow( table );
+	}
+
+	size_t batch_size;
+	batch_callback_t callback;
+	ColumnarBatch batch;
+	/** sequence number of the next sample */
+	uint64_t sequence;
+	/** fields of the sample being added */
+	std::vector<double> row;
+    };
+}
+
+#endif
@@ -0,0 +1,385 @@
+#include "CompressedSampleBuffer.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace aggregator;
+
+namespace
+{
+    /** smallest size of a block, in 64-bit words */
+    const size_t MIN_BLOCK_WORDS = 32;
+    /** bits of a sample period or value difference coded on 64 bits */
+    const size_t MAX_SIGNED_BITS = 5 + 64;
+    /** bits of an XOR coded value with a new bit window */
+    const size_t MAX_XOR_BITS = 2 + 6 + 6 + 64;
+
+    /** writes the count lowest bits of value, most significant first. The
+     * bits must still be zero */
+    void writeBits( uint64_t *words, size_t &bit, uint64_t value, unsigned count )
+    {
+	if( count < 64 )
+	    value &= (uint64_t(1) << count) - 1;
+	size_t word = bit / 64;
+	unsigned free = 64 - bit % 64;
+	if( count <= free )
+	    words[word] |= value << (free - count);
+	else
+	{
+	    words[word] |= value >> (count - free);
+	    words[word + 1] |= value << (64 - (count - free));
+	}
+	bit += count;
+    }
+
+    uint64_t readBits( const uint64_t *words, size_t &bit, unsigned count )
+    {
+	size_t word = bit / 64;
+	unsigned offset = bit % 64;
+	unsigned free = 64 - offset;
+	uint64_t result;
+	if( count <= free )
+	    result = (words[word] << offset) >> (64 - count);
+	else
+	{
+	    unsigned rest = count - free;
+	    result = ((words[word] << offset) >> offset) << rest | words[word + 1] >> (64 - rest);
+	}
+	bit += count;
+	return result;
+    }
+
+    /** codes small values with less bits, for the period differences and
+     * the integer value differences */
+    void writeSigned( uint64_t *words, size_t &bit, int64_t value )
+    {
+	if( value == 0 )
+	    writeBits( words, bit, 0, 1 );
+	else if( value >= -63 && value <= 64 )
+	{
+	    writeBits( words, bit, 2, 2 );
+	    writeBits( words, bit, value + 63, 7 );
+	}
+	else if( value >= -255 && value <= 256 )
+	{
+	    writeBits( words, bit, 6, 3 );
+	    writeBits( words, bit, value + 255, 9 );
+	}
+	else if( value >= -2047 && value <= 2048 )
+	{
+	    writeBits( words, bit, 14, 4 );
+	    writeBits( words, bit, value + 2047, 12 );
+	}
+	else if( value >= -524287 && value <= 524288 )
+	{
+	    writeBits( words, bit, 30, 5 );
+	    writeBits( words, bit, value + 524287, 20 );
+	}
+	else
+	{
+	    writeBits( words, bit, 31, 5 );
+	    writeBits( words, bit, value, 64 );
+	}
+    }
+
+    int64_t readSigned( const uint64_t *words, size_t &bit )
+    {
+	int prefix = 0;
+	while( prefix < 5 && readBits( words, bit, 1 ) )
+	    prefix++;
+
+	switch( prefix )
+	{
+	    case 0: return 0;
+	    case 1: return static_cast<int64_t>( readBits( words, bit, 7 ) ) - 63;
+	    case 2: return static_cast<int64_t>( readBits( words, bit, 9 ) ) - 255;
+	    case 3: return static_cast<int64_t>( readBits( words, bit, 12 ) ) - 2047;
+	    case 4: return static_cast<int64_t>( readBits( words, bit, 20 ) ) - 524287;
+	    default: return static_cast<int64_t>( readBits( words, bit, 64 ) );
+	}
+    }
+
+    unsigned leadingZeros( uint64_t x )
+    {
+#ifdef __GNUC__
+	return __builtin_clzll( x );
+#else
+	unsigned count = 0;
+	while( !(x & (uint64_t(1) << 63)) )
+	{
+	    x <<= 1;
+	    count++;
+	}
+	return count;
+#endif
+    }
+
+    unsigned trailingZeros( uint64_t x )
+    {
+#ifdef __GNUC__
+	return __builtin_ctzll( x );
+#else
+	unsigned count = 0;
+	while( !(x & 1) )
+	{
+	    x >>= 1;
+	    count++;
+	}
+	return count;
+#endif
+    }
+
+    /** codes the XOR of a value with the previous one. If the significant
+     * bits fit into the window of the previous value, only they are
+     * stored */
+    void writeXor( uint64_t *words, size_t &bit, uint64_t x, uint8_t &leading, uint8_t &length )
+    {
+	if( x == 0 )
+	{
+	    writeBits( words, bit, 0, 1 );
+	    return;
+	}
+
+	unsigned lead = leadingZeros( x );
+	unsigned trail = trailingZeros( x );
+	if( length && lead >= leading && trail >= 64u - leading - length )
+	{
+	    writeBits( words, bit, 2, 2 );
+	    writeBits( words, bit, x >> (64 - leading - length), length );
+	    return;
+	}
+
+	leading = lead;
+	length = 64 - lead - trail;
+	writeBits( words, bit, 3, 2 );
+	writeBits( words, bit, leading, 6 );
+	writeBits( words, bit, length - 1, 6 );
+	writeBits( words, bit, x >> trail, length );
+    }
+
+    uint64_t readXor( const uint64_t *words, size_t &bit, uint8_t &leading, uint8_t &length )
+    {
+	if( !readBits( words, bit, 1 ) )
+	    return 0;
+
+	if( readBits( words, bit, 1 ) )
+	{
+	    leading = readBits( words, bit, 6 );
+	    length = readBits( words, bit, 6 ) + 1;
+	}
+	return readBits( words, bit, length ) << (64 - leading - length);
+    }
+}
+
+CompressedSampleBuffer::CompressedSampleBuffer( size_t capacity, size_t channels, Coding coding, MemoryResource *resource )
+    : resource( resource ? resource : getDefaultMemoryResource() ),
+      memory( 0 ), channel_count( channels ), coding( coding ),
+      max_sample_bits( MAX_SIGNED_BITS + channels * std::max( MAX_SIGNED_BITS, MAX_XOR_BITS ) ),
+      block_words( std::max( MIN_BLOCK_WORDS, 4 * ((max_sample_bits + 63) / 64) ) ),
+      block_count( capacity / (block_words * sizeof(uint64_t)) ),
+      head( 0 ), tail( 0 ), sample_count( 0 ), stored_bits( 0 )
+{
+    if( channels == 0 )
+	throw std::runtime_error("CompressedSampleBuffer: samples must have at least one channel.");
+    if( block_count < 2 )
+	throw std::runtime_error("CompressedSampleBuffer: capacity is too small to hold two blocks.");
+
+    memory = static_cast<uint64_t*>( this->resource->allocate( this->capacity(), sizeof(uint64_t) ) );
+    blocks.resize( block_count );
+    resetReader( writer, 0 );
+    startBlock( 0 );
+}
+
+CompressedSampleBuffer::~CompressedSampleBuffer()
+{
+    resource->deallocate( memory, capacity(), sizeof(uint64_t) );
+}
+
+CompressedSampleBuffer& CompressedSampleBuffer::operator=( const CompressedSampleBuffer &other )
+{
+    if( this == &other )
+	return *this;
+
+    if( channel_count != other.channel_count || coding != other.coding || block_words != other.block_words )
+	throw std::runtime_error("CompressedSampleBuffer: cannot copy a buffer with another sample layout.");
+
+    if( block_count != other.block_count )
+    {
+	uint64_t *new_memory = static_cast<uint64_t*>( resource->allocate( other.capacity(), sizeof(uint64_t) ) );
+	resource->deallocate( memory, capacity(), sizeof(uint64_t) );
+	memory = new_memory;
+	block_count = other.block_count;
+    }
+
+    memcpy( memory, other.memory, capacity() );
+    blocks = other.blocks;
+    head = other.head;
+    tail = other.tail;
+    writer = other.writer;
+    sample_count = other.sample_count;
+    stored_bits = other.stored_bits;
+    return *this;
+}
+
+void CompressedSampleBuffer::startBlock( uint64_t block )
+{
+    memset( blockWords( block ), 0, block_words * sizeof(uint64_t) );
+    info( block ).bits = 0;
+    info( block ).count = 0;
+}
+
+void CompressedSampleBuffer::resetReader( Reader &reader, uint64_t block ) const
+{
+    reader.block = block;
+    reader.bit = 0;
+    reader.index = 0;
+    reader.time = 0;
+    reader.delta = 0;
+    reader.values.assign( channel_count, 0 );
+    reader.leading.assign( channel_count, 0 );
+    reader.length.assign( channel_count, 0 );
+}
+
+size_t CompressedSampleBuffer::push( const base::Time &time, const uint64_t *values )
+{
+    size_t dropped = 0;
+    if( writer.index > 0 && writer.bit + max_sample_bits > block_words * 64 )
+    {
+	if( tail - head + 1 == block_count )
+	{
+	    dropped = info( head ).count;
+	    sample_count -= dropped;
+	    stored_bits -= info( head ).bits;
+	    head++;
+	}
+	tail++;
+	startBlock( tail );
+	resetReader( writer, tail );
+    }
+
+    uint64_t *words = blockWords( tail );
+    size_t start = writer.bit;
+    int64_t us = time.toMicroseconds();
+    if( writer.index == 0 )
+    {
+	// the first sample of a block is not compressed
+	writeBits( words, writer.bit, us, 64 );
+	for( size_t i = 0; i < channel_count; ++i )
+	    writeBits( words, writer.bit, values[i], 64 );
+	writer.delta = 0;
+    }
+    else
+    {
+	int64_t delta = us - writer.time;
+	writeSigned( words, writer.bit, delta - writer.delta );
+	writer.delta = delta;
+	for( size_t i = 0; i < channel_count; ++i )
+	{
+	    if( coding == XOR_CODING )
+		writeXor( words, writer.bit, values[i] ^ writer.values[i], writer.leading[i], writer.length[i] );
+	    else
+		writeSigned( words, writer.bit, values[i] - writer.values[i] );
+	}
+    }
+    writer.time = us;
+    std::copy( values, values + channel_count, writer.values.begin() );
+    writer.index++;
+
+    info( tail ).bits = writer.bit;
+    info( tail ).count++;
+    stored_bits += writer.bit - start;
+    sample_count++;
+    return dropped;
+}
+
+size_t CompressedSampleBuffer::release( uint64_t block )
+{
+    size_t removed = 0;
+    while( head < block && head < tail )
+    {
+	removed += info( head ).count;
+	stored_bits -= info( head ).bits;
+	head++;
+    }
+    sample_count -= removed;
+    return removed;
+}
+
+void CompressedSampleBuffer::clear()
+{
+    head = tail;
+    startBlock( tail );
+    resetReader( writer, tail );
+    sample_count = 0;
+    stored_bits = 0;
+}
+
+base::Time CompressedSampleBuffer::frontTime() const
+{
+    if( empty() )
+	return base::Time();
+    size_t bit = 0;
+    return base::Time::fromMicroseconds( readBits( blockWords( head ), bit, 64 ) );
+}
+
+void CompressedSampleBuffer::begin( Reader &reader ) const
+{
+    resetReader( reader, head );
+}
+
+bool CompressedSampleBuffer::atEnd( const Reader &reader ) const
+{
+    // only the block being written can be empty, and only if the whole
+    // buffer is
+    return reader.block == tail && reader.index == info( tail ).count;
+}
+
+uint64_t CompressedSampleBuffer::neededBlock( const Reader &reader ) const
+{
+    if( reader.block < tail && reader.index == info( reader.block ).count )
+	return reader.block + 1;
+    return reader.block;
+}
+
+base::Time CompressedSampleBuffer::peekTime( const Reader &reader ) const
+{
+    size_t bit = reader.bit;
+    if( reader.index == info( reader.block ).count )
+    {
+	// first sample of the next block
+	bit = 0;
+	return base::Time::fromMicroseconds( readBits( blockWords( reader.block + 1 ), bit, 64 ) );
+    }
+    if( reader.index == 0 )
+	return base::Time::fromMicroseconds( readBits( blockWords( reader.block ), bit, 64 ) );
+    return base::Time::fromMicroseconds( reader.time + reader.delta + readSigned( blockWords( reader.block ), bit ) );
+}
+
+base::Time CompressedSampleBuffer::read( Reader &reader, uint64_t *values ) const
+{
+    if( reader.index == info( reader.block ).count )
+	resetReader( reader, reader.block + 1 );
+
+    const uint64_t *words = blockWords( reader.block );
+    if( reader.index == 0 )
+    {
+	reader.time = readBits( words, reader.bit, 64 );
+	for( size_t i = 0; i < channel_count; ++i )
+	    reader.values[i] = readBits( words, reader.bit, 64 );
+    }
+    else
+    {
+	reader.delta += readSigned( words, reader.bit );
+	reader.time += reader.delta;
+	for( size_t i = 0; i < channel_count; ++i )
+	{
+	    if( coding == XOR_CODING )
+		reader.values[i] ^= readXor( words, reader.bit, reader.leading[i], reader.length[i] );
+	    else
+		reader.values[i] += readSigned( words, reader.bit );
+	}
+    }
+    reader.index++;
+
+    std::copy( reader.values.begin(), reader.values.end(), values );
+    return base::Time::fromMicroseconds( reader.time );
+}
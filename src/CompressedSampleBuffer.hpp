@@ -0,0 +1,229 @@
+#ifndef __AGGREGATOR_COMPRESSEDSAMPLEBUFFER_HPP__
+#define __AGGREGATOR_COMPRESSEDSAMPLEBUFFER_HPP__
+
+#include <base/Time.hpp>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <boost/array.hpp>
+#include <boost/type_traits/is_floating_point.hpp>
+#include <boost/type_traits/is_integral.hpp>
+#include <boost/utility/enable_if.hpp>
+#include <aggregator/MemoryResource.hpp>
+
+namespace aggregator
+{
+    /** FIFO of timestamped numeric samples, stored compressed in a fixed
+     * number of blocks.
+     *
+     * A sample is a fixed count of channels, each held in a 64-bit word.
+     * The timestamps are coded as the difference between two successive
+     * sample periods (delta-of-delta), which takes a single bit for
+     * regularly sampled streams. The values are coded either as the XOR
+     * with the previous value, which suits slowly changing floating point
+     * values, or as the difference to the previous value, for integers.
+     *
+     * Each block starts with an uncompressed sample, so that blocks can be
+     * decoded on their own. When all blocks are full, the oldest one is
+     * dropped as a whole.
+     *
+     * Samples are read with Reader objects, which hold the position and the
+     * state of the decoder. Readers stay valid until the block they point
+     * into is removed, see release().
+     */
+    class CompressedSampleBuffer
+    {
+    public:
+	enum Coding
+	{
+	    /** XOR with the previous value, for floating point values */
+	    XOR_CODING,
+	    /** difference to the previous value, for integers */
+	    DELTA_CODING
+	};
+
+	struct Reader
+	{
+	    /** sequence number of the block */
+	    uint64_t block;
+	    /** offset of the next sample in the block, in bits */
+	    size_t bit;
+	    /** index of the next sample in the block */
+	    size_t index;
+	    /** time and period of the previous sample, in microseconds */
+	    int64_t time;
+	    int64_t delta;
+	    std::vector<uint64_t> values;
+	    /** bit window of the previous XOR coded values */
+	    std::vector<uint8_t> leading;
+	    std::vector<uint8_t> length;
+
+	    Reader()
+		: block( 0 ), bit( 0 ), index( 0 ), time( 0 ), delta( 0 ) {}
+	};
+
+	/** @param capacity - memory of the blocks in bytes. It must hold at
+	 *      least two blocks, see blockSize()
+	 * @param channels - count of 64-bit words per sample
+	 * @param resource - memory resource of the blocks. The default one is
+	 *      used if it is null
+	 */
+	CompressedSampleBuffer( size_t capacity, size_t channels, Coding coding, MemoryResource *resource = 0 );
+	~CompressedSampleBuffer();
+
+	/** copies the content of other into this buffer. Both buffers must
+	 * have the same layout */
+	CompressedSampleBuffer& operator=( const CompressedSampleBuffer &other );
+
+	/** The memory of the blocks in bytes */
+	size_t capacity() const { return block_count * block_words * sizeof(uint64_t); }
+	/** The size of a block in bytes, which depends on the channel count */
+	size_t blockSize() const { return block_words * sizeof(uint64_t); }
+	/** The count of bytes used by the coded samples */
+	size_t size() const { return (stored_bits + 7) / 8; }
+	/** The count of stored samples */
+	size_t count() const { return sample_count; }
+	bool empty() const { return sample_count == 0; }
+	size_t channels() const { return channel_count; }
+
+	/** Appends a sample, dropping the oldest block if all blocks are full
+	 *
+	 * @param values - the channel values of the sample
+	 * @return the count of samples in the dropped block, including the
+	 *      ones readers have already read
+	 */
+	size_t push( const base::Time &time, const uint64_t *values );
+
+	/** Removes the blocks before the given one
+	 *
+	 * @return the count of samples that have been removed
+	 */
+	size_t release( uint64_t block );
+
+	/** Removes all samples */
+	void clear();
+
+	/** The timestamp of the oldest sample */
+	base::Time frontTime() const;
+
+	/** The sequence number of the oldest block */
+	uint64_t frontBlock() const { return head; }
+
+	/** Sets reader to the oldest sample */
+	void begin( Reader &reader ) const;
+	/** @return a reader after the newest sample */
+	const Reader& end() const { return writer; }
+	/** @return false if the block of the reader has been removed */
+	bool isValid( const Reader &reader ) const { return reader.block >= head; }
+	/** @return true if there is no sample after the reader */
+	bool atEnd( const Reader &reader ) const;
+	/** @return the first block that is still needed by the reader */
+	uint64_t neededBlock( const Reader &reader ) const;
+
+	/** The timestamp of the next sample of the reader, which must not
+	 * be at the end */
+	base::Time peekTime( const Reader &reader ) const;
+	/** Decodes the next sample of the reader and moves the reader past
+	 * it. The reader must not be at the end.
+	 *
+	 * @param values - receives the channel values of the sample
+	 * @return the timestamp of the sample
+	 */
+	base::Time read( Reader &reader, uint64_t *values ) const;
+
+    private:
+	struct BlockInfo
+	{
+	    size_t bits;
+	    size_t count;
+	};
+
+	MemoryResource *resource;
+	uint64_t *memory;
+	size_t channel_count;
+	Coding coding;
+	/** largest count of bits used by a sample */
+	size_t max_sample_bits;
+	size_t block_words;
+	size_t block_count;
+	std::vector<BlockInfo> blocks;
+	/** sequence numbers of the oldest block and of the block being
+	 * written */
+	uint64_t head;
+	uint64_t tail;
+	/** state of the encoder, which is also the reader at the end */
+	Reader writer;
+	size_t sample_count;
+	size_t stored_bits;
+
+	uint64_t* blockWords( uint64_t block ) const { return memory + (block % block_count) * block_words; }
+	const BlockInfo& info( uint64_t block ) const { return blocks[block % block_count]; }
+	BlockInfo& info( uint64_t block ) { return blocks[block % block_count]; }
+	void startBlock( uint64_t block );
+	void resetReader( Reader &reader, uint64_t block ) const;
+
+	CompressedSampleBuffer( const CompressedSampleBuffer& );
+    };
+
+    /** Conversion of a sample type to the channels of a
+     * CompressedSampleBuffer. It is defined for the arithmetic types and
+     * for boost::array of them, and can be specialized for other small
+     * numeric types.
+     */
+    template <class T, class Enable = void> struct CompressedSampleTraits;
+
+    template <class T> struct CompressedSampleTraits<T, typename boost::enable_if< boost::is_floating_point<T> >::type>
+    {
+	static const size_t channels = 1;
+	static const CompressedSampleBuffer::Coding coding = CompressedSampleBuffer::XOR_CODING;
+
+	static void toWords( const T &value, uint64_t *words )
+	{
+	    double d = value;
+	    memcpy( words, &d, sizeof(d) );
+	}
+
+	static void fromWords( const uint64_t *words, T &value )
+	{
+	    double d;
+	    memcpy( &d, words, sizeof(d) );
+	    value = d;
+	}
+    };
+
+    template <class T> struct CompressedSampleTraits<T, typename boost::enable_if< boost::is_integral<T> >::type>
+    {
+	static const size_t channels = 1;
+	static const CompressedSampleBuffer::Coding coding = CompressedSampleBuffer::DELTA_CODING;
+
+	static void toWords( const T &value, uint64_t *words )
+	{
+	    words[0] = static_cast<int64_t>( value );
+	}
+
+	static void fromWords( const uint64_t *words, T &value )
+	{
+	    value = static_cast<T>( static_cast<int64_t>( words[0] ) );
+	}
+    };
+
+    template <class T, size_t N> struct CompressedSampleTraits< boost::array<T,N> >
+    {
+	static const size_t channels = N;
+	static const CompressedSampleBuffer::Coding coding = CompressedSampleTraits<T>::coding;
+
+	static void toWords( const boost::array<T,N> &value, uint64_t *words )
+	{
+	    for( size_t i = 0; i < N; ++i )
+		CompressedSampleTraits<T>::toWords( value[i], words + i );
+	}
+
+	static void fromWords( const uint64_t *words, boost::array<T,N> &value )
+	{
+	    for( size_t i = 0; i < N; ++i )
+		CompressedSampleTraits<T>::fromWords( words + i, value[i] );
+	}
+    };
+}
+
+#endif
@@ -3,7 +3,11 @@
 
 #include <base/Time.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/intrusive_ptr.hpp>
 #include <stdexcept>
+#if __cplusplus >= 201103L
+#include <memory>
+#endif
 
 namespace aggregator
 {
@@ -40,6 +44,29 @@ inline base::Time determineTimestamp(const boost::shared_ptr<T>& type)
     return determineTimestamp(*type);
 }
 
+template<typename T>
+inline base::Time determineTimestamp(const boost::intrusive_ptr<T>& type)
+{
+    if (type.get() == NULL) throw std::invalid_argument("determineTimestamp: Received null pointer in function!");
+    return determineTimestamp(*type);
+}
+
+#if __cplusplus >= 201103L
+template<typename T>
+inline base::Time determineTimestamp(const std::shared_ptr<T>& type)
+{
+    if (type.get() == NULL) throw std::invalid_argument("determineTimestamp: Received null pointer in function!");
+    return determineTimestamp(*type);
+}
+
+template<typename T, typename D>
+inline base::Time determineTimestamp(const std::unique_ptr<T, D>& type)
+{
+    if (type.get() == NULL) throw std::invalid_argument("determineTimestamp: Received null pointer in function!");
+    return determineTimestamp(*type);
+}
+#endif
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,359 @@
+#ifndef __AGGREGATOR_FANOUTSTREAMALIGNER_HPP__
+#define __AGGREGATOR_FANOUTSTREAMALIGNER_HPP__
+
+#include <aggregator/StreamAligner.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+#include <deque>
+
+namespace aggregator
+{
+    /** A stream aligner which merges its streams once and hands the ordered
+     * output to any number of subscribers.
+     *
+     * The streams buffer boost::shared_ptr<const T> handles instead of the
+     * samples themselves. The merged samples are appended to a single output
+     * queue, from which every subscriber reads through its own cursor, so that
+     * neither buffering, merging nor delivery copies the samples, regardless
+     * of the number of subscribers.
+     *
+     * A subscriber that lags behind the merged output by more than its
+     * maximum lag loses its oldest pending samples. Samples are released as
+     * soon as all subscribers either consumed or dropped them.
+     *
+     * The shared handles and the output queue are allocated at runtime, so
+     * this class does not provide the guarantees of
+     * StreamAligner::setRealtimeMode().
+     */
+    class FanOutStreamAligner : public StreamAligner
+    {
+	class SubscriberCallbackBase
+	{
+	public:
+	    virtual ~SubscriberCallbackBase() {}
+	    virtual void call( const base::Time &ts, const boost::shared_ptr<const void> &sample ) = 0;
+	};
+
+	template <class T> class SubscriberCallback : public SubscriberCallbackBase
+	{
+	public:
+	    typedef boost::function<void (const base::Time &ts, const boost::shared_ptr<const T> &value)> callback_t;
+
+	    explicit SubscriberCallback( callback_t callback )
+		: callback( callback ) {}
+
+	    void call( const base::Time &ts, const boost::shared_ptr<const void> &sample )
+	    {
+		callback( ts, boost::static_pointer_cast<const T>( sample ) );
+	    }
+
+	protected:
+	    callback_t callback;
+	};
+
+	struct OutputSample
+	{
+	    base::Time time;
+	    int stream_idx;
+	    boost::shared_ptr<const void> sample;
+	};
+
+	struct Subscriber
+	{
+	    /** sequence number of the next output sample for this subscriber */
+	    uint64_t next;
+	    std::vector<SubscriberCallbackBase*> callbacks;
+	    SubscriberStatus status;
+	};
+
+    public:
+	template <class T> struct subscriber_callback
+	{
+	    typedef typename SubscriberCallback<T>::callback_t type;
+	};
+
+	explicit FanOutStreamAligner(base::Time timeout = base::Time::fromSeconds(1))
+	    : StreamAligner( timeout ), output_begin( 0 ) {}
+
+	~FanOutStreamAligner()
+	{
+	    for(size_t i=0;i<subscribers.size();i++)
+		deleteSubscriber( i );
+	}
+
+	/** Will register a stream with the aggregator.
+	 *
+	 * The stream buffers shared handles on the samples. The merged
+	 * samples are delivered to the callbacks set with
+	 * setSubscriberCallback().
+	 *
+	 * See StreamAligner::registerStream for the parameters.
+	 */
+	template <class T> int registerStream( int bufferSize, base::Time period, int priority = -1, const std::string &name = std::string() )
+	{
+	    int idx = StreamAligner::registerStream< boost::shared_ptr<const T> >(
+		    typename Stream< boost::shared_ptr<const T> >::callback_t(), bufferSize, period, priority, name );
+	    getStream< boost::shared_ptr<const T> >( idx )->setCallback(
+		    boost::bind( &FanOutStreamAligner::appendOutput, this, idx, _1, _2 ) );
+	    return idx;
+	}
+
+	/** Removes the stream with the given index, and discards its samples
+	 * which are still waiting for subscribers.
+	 */
+	void unregisterStream( int idx )
+	{
+	    StreamAligner::unregisterStream( idx );
+
+	    for(std::deque<OutputSample>::iterator it=output.begin();it != output.end();it++)
+	    {
+		if( it->stream_idx == idx )
+		{
+		    it->stream_idx = -1;
+		    it->sample.reset();
+		}
+	    }
+
+	    for(size_t i=0;i<subscribers.size();i++)
+	    {
+		if( subscribers[i] && idx < static_cast<int>(subscribers[i]->callbacks.size()) )
+		{
+		    delete subscribers[i]->callbacks[idx];
+		    subscribers[i]->callbacks[idx] = 0;
+		}
+	    }
+	}
+
+	/** @brief Push a new sample into the stream
+	 *
+	 * The sample is copied once into a shared handle.
+	 */
+	template <class T> void push( int idx, const base::Time &ts, const T &data )
+	{
+	    StreamAligner::push( idx, ts, boost::shared_ptr<const T>( new T( data ) ) );
+	}
+
+	/** @brief Push a shared sample into the stream without copying it
+	 *
+	 * The sample must not be modified after it has been pushed.
+	 */
+	template <class T> void push( int idx, const base::Time &ts, const boost::shared_ptr<const T> &data )
+	{
+	    StreamAligner::push( idx, ts, data );
+	}
+
+	/** @overload */
+	template <class T> void push( int idx, const base::Time &ts, const boost::shared_ptr<T> &data )
+	{
+	    StreamAligner::push( idx, ts, boost::shared_ptr<const T>( data ) );
+	}
+
+	/** @brief Push a sample or a shared sample into the stream, using its
+	 * timestamp as given by determineTimestamp()
+	 */
+	template <class T> void push( int idx, const T &data )
+	{
+	    push( idx, determineTimestamp( data ), data );
+	}
+
+	/** Adds a subscriber to the merged output
+	 *
+	 * @param max_lag - the maximum number of merged samples that may
+	 *      wait for this subscriber. When more samples are waiting, the
+	 *      oldest ones get dropped for this subscriber.
+	 *
+	 * @result - subscriber index, which is used to identify the
+	 *      subscriber (e.g. for step(int))
+	 */
+	int subscribe( size_t max_lag )
+	{
+	    if( max_lag == 0 )
+		throw std::runtime_error("maximum subscriber lag must be at least one sample.");
+
+	    Subscriber *subscriber = new Subscriber();
+	    subscriber->next = output_begin + output.size();
+	    subscriber->status.max_lag = max_lag;
+
+	    for(size_t i = 0; i < subscribers.size(); i++)
+	    {
+		if(!subscribers[i])
+		{
+		    subscribers[i] = subscriber;
+		    return i;
+		}
+	    }
+
+	    subscribers.push_back( subscriber );
+	    return subscribers.size() - 1;
+	}
+
+	/** Removes the subscriber with the given index */
+	void unsubscribe( int subscriber )
+	{
+	    getSubscriber( subscriber );
+	    deleteSubscriber( subscriber );
+	    releaseOutput();
+	}
+
+	/** Sets the callback through which the given subscriber receives the
+	 * samples of the given stream. Samples of streams without a callback
+	 * are skipped for that subscriber.
+	 */
+	template <class T> void setSubscriberCallback( int subscriber, int stream_idx, typename subscriber_callback<T>::type callback )
+	{
+	    getStream< boost::shared_ptr<const T> >( stream_idx );
+
+	    Subscriber &sub( getSubscriber( subscriber ) );
+	    if( static_cast<int>(sub.callbacks.size()) <= stream_idx )
+		sub.callbacks.resize( stream_idx + 1 );
+
+	    delete sub.callbacks[stream_idx];
+	    sub.callbacks[stream_idx] = new SubscriberCallback<T>( callback );
+	}
+
+	/** Merges the next sample from the streams, see
+	 * StreamAligner::step(). The merged sample is appended to the output
+	 * of the subscribers, and released right away if there are none.
+	 */
+	using StreamAligner::step;
+
+	/** Delivers the next merged sample to the given subscriber.
+	 *
+	 * If the subscriber already got all merged samples, this merges the
+	 * next sample from the streams first (see StreamAligner::step()).
+	 *
+	 * Note that this hides StreamAligner::step(int): the subscribers all
+	 * share the first read cursor of the aligner.
+	 *
+	 * @result - true if a sample was consumed by the subscriber and more
+	 *      data might be available
+	 */
+	bool step( int subscriber )
+	{
+	    Subscriber &sub( getSubscriber( subscriber ) );
+
+	    // streams registered through the StreamAligner interface, e.g. tick
+	    // streams, do not append to the output
+	    while( sub.next == output_begin + output.size() )
+	    {
+		if( !StreamAligner::step() )
+		    return false;
+	    }
+
+	    // the merge might have dropped samples for this subscriber
+	    const OutputSample &sample( output[sub.next - output_begin] );
+	    sub.next++;
+
+	    if( sample.stream_idx >= 0 && sample.stream_idx < static_cast<int>(sub.callbacks.size()) && sub.callbacks[sample.stream_idx] )
+	    {
+		sub.status.samples_delivered++;
+		sub.callbacks[sample.stream_idx]->call( sample.time, sample.sample );
+	    }
+
+	    releaseOutput();
+	    return true;
+	}
+
+	/** clears all samples in all streams and in the output queue,
+	 * resets the statistics and the playback times, but leaves the
+	 * stream and subscriber setup intact.
+	 */
+	void clear()
+	{
+	    StreamAligner::clear();
+
+	    output_begin += output.size();
+	    output.clear();
+	    for(size_t i=0;i<subscribers.size();i++)
+	    {
+		if( subscribers[i] )
+		{
+		    subscribers[i]->next = output_begin;
+		    subscribers[i]->status.samples_dropped_lag = 0;
+		}
+	    }
+	}
+
+	/** @return the status of the subscriber with the given index */
+	const SubscriberStatus &getSubscriberStatus( int subscriber ) const
+	{
+	    Subscriber &sub( getSubscriber( subscriber ) );
+	    sub.status.lag = output_begin + output.size() - sub.next;
+	    return sub.status;
+	}
+
+    protected:
+	Subscriber &getSubscriber( int subscriber ) const
+	{
+	    if( !subscribers.at(subscriber) )
+		throw std::runtime_error("invalid subscriber index.");
+	    return *subscribers[subscriber];
+	}
+
+	void deleteSubscriber( int subscriber )
+	{
+	    if( !subscribers[subscriber] )
+		return;
+
+	    for(size_t i=0;i<subscribers[subscriber]->callbacks.size();i++)
+		delete subscribers[subscriber]->callbacks[i];
+	    delete subscribers[subscriber];
+	    subscribers[subscriber] = 0;
+	}
+
+	/** callback of all streams, which appends the merged sample to the
+	 * output queue
+	 */
+	void appendOutput( int idx, const base::Time &ts, const boost::shared_ptr<const void> &sample )
+	{
+	    OutputSample out;
+	    out.time = ts;
+	    out.stream_idx = idx;
+	    out.sample = sample;
+	    output.push_back( out );
+
+	    uint64_t end = output_begin + output.size();
+	    for(size_t i=0;i<subscribers.size();i++)
+	    {
+		Subscriber *sub = subscribers[i];
+		if( sub && end - sub->next > sub->status.max_lag )
+		{
+		    sub->status.samples_dropped_lag += end - sub->next - sub->status.max_lag;
+		    sub->next = end - sub->status.max_lag;
+		}
+	    }
+
+	    // the output would otherwise grow without bound when the aligner
+	    // is stepped without subscriber
+	    releaseOutput();
+	}
+
+	/** removes the samples from the output queue that have been consumed
+	 * by all subscribers
+	 */
+	void releaseOutput()
+	{
+	    uint64_t min_next = output_begin + output.size();
+	    for(size_t i=0;i<subscribers.size();i++)
+	    {
+		if( subscribers[i] && subscribers[i]->next < min_next )
+		    min_next = subscribers[i]->next;
+	    }
+
+	    while( output_begin < min_next )
+	    {
+		output.pop_front();
+		output_begin++;
+	    }
+	}
+
+	std::deque<OutputSample> output;
+	/** sequence number of the first sample in output */
+	uint64_t output_begin;
+
+	typedef std::vector<Subscriber*> subscriber_vector;
+	subscriber_vector subscribers;
+    };
+}
+
+#endif
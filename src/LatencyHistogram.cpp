@@ -0,0 +1,57 @@
+#include "LatencyHistogram.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace aggregator;
+
+LatencyHistogram::LatencyHistogram()
+{
+    clear();
+}
+
+int LatencyHistogram::getBucket( const base::Time &duration )
+{
+    int64_t usec = duration.toMicroseconds();
+    if( usec < 1 )
+	return 0;
+
+    // bucket i > 0 holds the durations below 2^(i/BUCKETS_PER_OCTAVE) usec
+    int bucket = 1 + static_cast<int>( BUCKETS_PER_OCTAVE * std::log( static_cast<double>( usec ) ) / std::log( 2.0 ) );
+    return std::min( bucket, BUCKET_COUNT - 1 );
+}
+
+base::Time LatencyHistogram::getUpperBound( int bucket )
+{
+    return base::Time::fromMicroseconds( static_cast<int64_t>( std::ceil( std::pow( 2.0, static_cast<double>( bucket ) / BUCKETS_PER_OCTAVE ) ) ) );
+}
+
+void LatencyHistogram::add( const base::Time &duration )
+{
+    counts[getBucket( duration )]++;
+    total++;
+    if( duration > maximum )
+	maximum = duration;
+}
+
+base::Time LatencyHistogram::getPercentile( double fraction ) const
+{
+    if( !total )
+	return base::Time();
+
+    uint64_t target = std::max( static_cast<uint64_t>( 1 ), static_cast<uint64_t>( std::ceil( fraction * total ) ) );
+    uint64_t count = 0;
+    for( int i = 0; i < BUCKET_COUNT; i++ )
+    {
+	count += counts[i];
+	if( count >= target )
+	    return std::min( getUpperBound( i ), maximum );
+    }
+    return maximum;
+}
+
+void LatencyHistogram::clear()
+{
+    std::fill( counts, counts + BUCKET_COUNT, 0 );
+    total = 0;
+    maximum = base::Time();
+}
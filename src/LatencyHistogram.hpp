@@ -0,0 +1,54 @@
+#ifndef __AGGREGATOR_LATENCYHISTOGRAM_HPP__
+#define __AGGREGATOR_LATENCYHISTOGRAM_HPP__
+
+#include <base/Time.hpp>
+#include <stdint.h>
+
+namespace aggregator
+{
+    /** Histogram of durations with logarithmic buckets, from which
+     * percentiles can be read.
+     *
+     * The buckets are a quarter of an octave wide, starting at one
+     * microsecond, so that percentiles are given with a relative error below
+     * 19%. Durations up to about an hour are resolved, longer ones go into
+     * the last bucket. Negative durations are counted as zero. Adding a
+     * duration is constant time and does not allocate.
+     */
+    class LatencyHistogram
+    {
+    public:
+	/** count of buckets per octave */
+	static const int BUCKETS_PER_OCTAVE = 4;
+	static const int BUCKET_COUNT = 128;
+
+    private:
+	uint64_t counts[BUCKET_COUNT];
+	uint64_t total;
+	base::Time maximum;
+
+	static int getBucket( const base::Time &duration );
+	static base::Time getUpperBound( int bucket );
+
+    public:
+	LatencyHistogram();
+
+	void add( const base::Time &duration );
+
+	/** @return the duration below which the given fraction of the added
+	 *      durations lie, or a null time if the histogram is empty
+	 * @param fraction - between 0 and 1, e.g. 0.99 for the 99th percentile
+	 */
+	base::Time getPercentile( double fraction ) const;
+
+	/** @return the largest duration that has been added */
+	base::Time getMaximum() const { return maximum; }
+
+	/** @return the count of durations that have been added */
+	uint64_t getCount() const { return total; }
+
+	void clear();
+    };
+}
+
+#endif
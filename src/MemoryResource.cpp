@@ -0,0 +1,29 @@
+#include "MemoryResource.hpp"
+
+namespace
+{
+    class NewDeleteMemoryResource : public aggregator::MemoryResource
+    {
+    protected:
+	void* doAllocate( size_t bytes, size_t alignment )
+	{
+	    return ::operator new( bytes );
+	}
+
+	void doDeallocate( void *ptr, size_t bytes, size_t alignment )
+	{
+	    ::operator delete( ptr );
+	}
+
+	bool doIsEqual( const aggregator::MemoryResource &other ) const
+	{
+	    return dynamic_cast<const NewDeleteMemoryResource*>( &other ) != 0;
+	}
+    };
+}
+
+aggregator::MemoryResource* aggregator::getDefaultMemoryResource()
+{
+    static NewDeleteMemoryResource resource;
+    return &resource;
+}
@@ -0,0 +1,163 @@
+#ifndef __AGGREGATOR_MEMORYRESOURCE_HPP__
+#define __AGGREGATOR_MEMORYRESOURCE_HPP__
+
+#include <cstddef>
+#include <new>
+#include <boost/type_traits/alignment_of.hpp>
+#if __cplusplus >= 201103L
+#include <utility>
+#endif
+
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#endif
+
+namespace aggregator
+{
+    /** Source of the memory used by the stream aligner for its streams and
+     * stream buffers.
+     *
+     * This follows the interface of std::pmr::memory_resource, so that the
+     * buffers can be placed in memory chosen by the user (e.g. a monotonic
+     * arena, hugepage-backed or locked memory). See PmrMemoryResource to use
+     * a std::pmr::memory_resource directly.
+     */
+    class MemoryResource
+    {
+    public:
+	virtual ~MemoryResource() {}
+
+	void* allocate( size_t bytes, size_t alignment )
+	{
+	    return doAllocate( bytes, alignment );
+	}
+
+	void deallocate( void *ptr, size_t bytes, size_t alignment )
+	{
+	    doDeallocate( ptr, bytes, alignment );
+	}
+
+	/** Two resources are equal if memory allocated from one of them can
+	 * be deallocated by the other
+	 */
+	bool isEqual( const MemoryResource &other ) const
+	{
+	    return this == &other || doIsEqual( other );
+	}
+
+    protected:
+	virtual void* doAllocate( size_t bytes, size_t alignment ) = 0;
+	virtual void doDeallocate( void *ptr, size_t bytes, size_t alignment ) = 0;
+	virtual bool doIsEqual( const MemoryResource &other ) const { return false; }
+    };
+
+    /** @return the memory resource which uses operator new and operator
+     * delete. It is used when no other resource is provided.
+     */
+    MemoryResource* getDefaultMemoryResource();
+
+#if __cplusplus >= 201703L
+    /** Adapter that allocates from a std::pmr::memory_resource
+     */
+    class PmrMemoryResource : public MemoryResource
+    {
+    public:
+	explicit PmrMemoryResource( std::pmr::memory_resource *resource )
+	    : resource( resource ) {}
+
+	std::pmr::memory_resource* getResource() const { return resource; }
+
+    protected:
+	void* doAllocate( size_t bytes, size_t alignment )
+	{
+	    return resource->allocate( bytes, alignment );
+	}
+
+	void doDeallocate( void *ptr, size_t bytes, size_t alignment )
+	{
+	    resource->deallocate( ptr, bytes, alignment );
+	}
+
+	bool doIsEqual( const MemoryResource &other ) const
+	{
+	    const PmrMemoryResource *pmr = dynamic_cast<const PmrMemoryResource*>( &other );
+	    return pmr && resource->is_equal( *pmr->resource );
+	}
+
+    private:
+	std::pmr::memory_resource *resource;
+    };
+#endif
+
+    /** Standard allocator which takes its memory from a MemoryResource
+     */
+    template <class T> class ResourceAllocator
+    {
+    public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template <class U> struct rebind
+	{
+	    typedef ResourceAllocator<U> other;
+	};
+
+	ResourceAllocator()
+	    : resource( getDefaultMemoryResource() ) {}
+
+	/** Allocates from the given resource, or from the default one if
+	 * resource is null
+	 */
+	ResourceAllocator( MemoryResource *resource )
+	    : resource( resource ? resource : getDefaultMemoryResource() ) {}
+
+	template <class U> ResourceAllocator( const ResourceAllocator<U> &other )
+	    : resource( other.getResource() ) {}
+
+	MemoryResource* getResource() const { return resource; }
+
+	pointer address( reference x ) const { return &x; }
+	const_pointer address( const_reference x ) const { return &x; }
+
+	pointer allocate( size_type n, const void* = 0 )
+	{
+	    return static_cast<pointer>( resource->allocate( n * sizeof(T), boost::alignment_of<T>::value ) );
+	}
+
+	void deallocate( pointer ptr, size_type n )
+	{
+	    resource->deallocate( ptr, n * sizeof(T), boost::alignment_of<T>::value );
+	}
+
+	size_type max_size() const { return size_type(-1) / sizeof(T); }
+
+#if __cplusplus >= 201103L
+	template <class U, class... Args> void construct( U *ptr, Args&&... args ) { new (static_cast<void*>(ptr)) U( std::forward<Args>(args)... ); }
+#else
+	void construct( pointer ptr, const T &value ) { new (static_cast<void*>(ptr)) T( value ); }
+#endif
+	void destroy( pointer ptr ) { ptr->~T(); }
+
+    private:
+	MemoryResource *resource;
+    };
+
+    template <class T, class U>
+    bool operator==( const ResourceAllocator<T> &a, const ResourceAllocator<U> &b )
+    {
+	return a.getResource()->isEqual( *b.getResource() );
+    }
+
+    template <class T, class U>
+    bool operator!=( const ResourceAllocator<T> &a, const ResourceAllocator<U> &b )
+    {
+	return !(a == b);
+    }
+}
+
+#endif
@@ -10,18 +10,75 @@ namespace aggregator
 	class PullStreamBase 
 	{
 	public:
-	    PullStreamBase() : has_data(false) {}
+	    PullStreamBase( int stream_index, const std::string &name ) : has_data(false) 
+	    {
+		status.index = stream_index;
+		status.name = name;
+	    }
 	    virtual ~PullStreamBase() {}
-	    virtual void pull() = 0;
 	    virtual void push() = 0; 
 	    virtual void copyState( const PullStreamBase& other ) = 0; 
 
+	    /** calls the pull callback, timing it if the clock is set */
+	    void pull( const arrival_clock_t &clock )
+	    {
+		base::Time start;
+		AGGREGATOR_STATUS_UPDATE( if( clock ) start = clock(); )
+
+		has_data = pullSample();
+
+		AGGREGATOR_STATUS_UPDATE( 
+			status.pulls++;
+			if( has_data )
+			{
+			    status.records++;
+			    latest_ts = last_ts;
+			}
+			else
+			    status.empty_pulls++;
+			if( clock )
+			    pull_time.add( clock() - start ); )
+	    }
+
 	    base::Time lastTime() const { return last_ts; }
 	    bool hasData() const { return has_data; }
+	    int getIndex() const { return status.index; }
+
+	    /** @return the status of the source, the lead being computed
+	     * against the given current time */
+	    const PullSourceStatus& getStatus( const base::Time &current ) const
+	    {
+		status.pull_time_median = pull_time.getPercentile( 0.5 );
+		status.pull_time_p90 = pull_time.getPercentile( 0.9 );
+		status.pull_time_p99 = pull_time.getPercentile( 0.99 );
+		status.pull_time_max = pull_time.getMaximum();
+		status.lead = status.records ? latest_ts - current : base::Time();
+		status.pending = has_data;
+		return status;
+	    }
+
+	    /** resets the counters and the timing of the source. A sample
+	     * that has been read but not pushed yet is kept */
+	    void clearStatus()
+	    {
+		status.pulls = 0;
+		status.empty_pulls = 0;
+		status.records = 0;
+		latest_ts = base::Time();
+		pull_time.clear();
+	    }
 
 	protected:
+	    virtual bool pullSample() = 0;
+
 	    base::Time last_ts;
 	    bool has_data;
+
+	    mutable PullSourceStatus status;
+	    /** time of the latest sample read from the source */
+	    base::Time latest_ts;
+	    /** durations of the pull callback calls */
+	    LatencyHistogram pull_time;
 	};
 
 	template <class T> class PullStream : public PullStreamBase 
@@ -29,18 +86,13 @@ namespace aggregator
 	public:
 	    typedef boost::function<bool (base::Time&, T&)> pull_callback_t;
 
-	    PullStream( pull_callback_t pull_callback, StreamAligner* sa, size_t stream_index )
-		: stream_idx( stream_index ), sa( sa ), pull_callback( pull_callback ) {}
-
-	    void pull()
-	    {
-		has_data = pull_callback( last_ts, last_data );
-	    }
+	    PullStream( pull_callback_t pull_callback, StreamAligner* sa, size_t stream_index, const std::string &name )
+		: PullStreamBase( stream_index, name ), sa( sa ), pull_callback( pull_callback ) {}
 
 	    void push()
 	    {
 		if( has_data )
-		    sa->push( stream_idx, last_ts, last_data );
+		    sa->push( status.index, last_ts, last_data );
 
 		has_data = false;	
 	    }
@@ -52,7 +104,11 @@ namespace aggregator
 	    }
 
 	protected:
-	    int stream_idx;
+	    bool pullSample()
+	    {
+		return pull_callback( last_ts, last_data );
+	    }
+
 	    StreamAligner *sa;
 
 	    pull_callback_t pull_callback;
@@ -67,21 +123,64 @@ namespace aggregator
 	}
 
     public:
+	/** Registers a stream whose samples are read from a pull callback
+	 *
+	 * The callback is called by pull() whenever the stream has no sample
+	 * waiting, and returns false if it has no sample to give. See
+	 * StreamAligner::registerStream() for the other parameters.
+	 */
 	template <class T> 
 	int registerStream( typename PullStream<T>::pull_callback_t pull_callback, 
-		typename Stream<T>::callback_t callback, int bufferSize, base::Time period, int priority  = -1 ) 
+		typename Stream<T>::callback_t callback, int bufferSize, base::Time period, int priority  = -1,
+		const std::string &name = std::string(), MemoryResource *resource = 0 ) 
 	{
-	    int idx = StreamAligner::registerStream<T>( callback, bufferSize, period, priority );
-	    pull_streams.push_back( new PullStream<T>( pull_callback, this, idx ) );
+	    int idx = StreamAligner::registerStream<T>( callback, bufferSize, period, priority, name, resource );
+	    pull_streams.push_back( new PullStream<T>( pull_callback, this, idx, name ) );
 	    return idx;
 	}
 
+	/** Enables the measurement of the time spent in the pull callbacks,
+	 * reported in PullSourceStatus
+	 *
+	 * @param clock - gives the current time. It is called twice per pull
+	 */
+	void enablePullTiming( arrival_clock_t clock = &base::Time::now )
+	{
+	    pull_clock = clock;
+	}
+
+	void disablePullTiming()
+	{
+	    pull_clock = arrival_clock_t();
+	}
+
+	/** @return the status of the pull source of the given stream */
+	const PullSourceStatus& getPullStatus( int idx ) const
+	{
+	    for(size_t i=0;i<pull_streams.size();i++)
+	    {
+		if( pull_streams[i]->getIndex() == idx )
+		    return pull_streams[i]->getStatus( getCurrentTime() );
+	    }
+	    throw std::runtime_error("invalid pull stream index.");
+	}
+
+	/** Clears the stream aligner (see StreamAligner::clear()) and resets
+	 * the statistics of the pull sources
+	 */
+	void clear()
+	{
+	    StreamAligner::clear();
+	    for(size_t i=0;i<pull_streams.size();i++)
+		pull_streams[i]->clearStatus();
+	}
+
 	bool pull()
 	{
 	    for(pull_stream_vector::iterator it=pull_streams.begin();it != pull_streams.end();it++)
 	    {
 		if( !(*it)->hasData() )
-		    (*it)->pull();
+		    (*it)->pull( pull_clock );
 	    }
 	    std::sort( pull_streams.begin(), pull_streams.end(), &comparePullStreams );
 
@@ -114,6 +213,8 @@ namespace aggregator
     protected:
 	typedef std::vector<PullStreamBase*> pull_stream_vector;
 	pull_stream_vector pull_streams;
+	/** clock timing the pull callbacks, see enablePullTiming() */
+	arrival_clock_t pull_clock;
     };
 }
 
@@ -0,0 +1,71 @@
+#include "ReadinessNotifier.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <string>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+using namespace aggregator;
+
+ReadinessNotifier::ReadinessNotifier()
+    : read_fd( -1 ), write_fd( -1 ), ready( false )
+{
+#ifdef __linux__
+    read_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    if( read_fd < 0 )
+	throw std::runtime_error(std::string("ReadinessNotifier: cannot create the eventfd: ") + strerror(errno));
+    write_fd = read_fd;
+#else
+    int fds[2];
+    if( pipe( fds ) != 0 )
+	throw std::runtime_error(std::string("ReadinessNotifier: cannot create the pipe: ") + strerror(errno));
+    for( int i = 0; i < 2; ++i )
+    {
+	fcntl( fds[i], F_SETFL, fcntl( fds[i], F_GETFL ) | O_NONBLOCK );
+	fcntl( fds[i], F_SETFD, FD_CLOEXEC );
+    }
+    read_fd = fds[0];
+    write_fd = fds[1];
+#endif
+}
+
+ReadinessNotifier::~ReadinessNotifier()
+{
+    close( read_fd );
+    if( write_fd != read_fd )
+	close( write_fd );
+}
+
+void ReadinessNotifier::set( bool ready )
+{
+    if( ready == this->ready )
+	return;
+    this->ready = ready;
+
+    if( ready )
+    {
+#ifdef __linux__
+	uint64_t one = 1;
+	ssize_t ret = write( write_fd, &one, sizeof(one) );
+#else
+	char one = 1;
+	ssize_t ret = write( write_fd, &one, sizeof(one) );
+#endif
+	(void)ret;
+    }
+    else
+    {
+	// an eventfd is drained by a single read, a pipe holds at most one
+	// byte since it is only written on the transitions
+	uint64_t count;
+	ssize_t ret;
+	do
+	    ret = read( read_fd, &count, sizeof(count) );
+	while( ret < 0 && errno == EINTR );
+    }
+}
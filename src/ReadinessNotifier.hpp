@@ -0,0 +1,39 @@
+#ifndef __AGGREGATOR_READINESSNOTIFIER_HPP__
+#define __AGGREGATOR_READINESSNOTIFIER_HPP__
+
+namespace aggregator
+{
+    /** File descriptor that is readable while a condition holds, to wait
+     * for it in a select(), poll() or epoll() loop.
+     *
+     * It is an eventfd on Linux, and a pipe elsewhere. The descriptor is
+     * non-blocking and is only written or drained when the condition
+     * changes, so that setting the same state again costs no system call.
+     * The owner of the notifier must drain it, the readers must not read
+     * from it.
+     */
+    class ReadinessNotifier
+    {
+	int read_fd;
+	int write_fd;
+	bool ready;
+
+	ReadinessNotifier( const ReadinessNotifier& );
+	ReadinessNotifier& operator=( const ReadinessNotifier& );
+
+    public:
+	/** Throws if the descriptor can not be created */
+	ReadinessNotifier();
+	~ReadinessNotifier();
+
+	/** The descriptor to wait on for readability */
+	int getFileDescriptor() const { return read_fd; }
+
+	/** Makes the descriptor readable or not */
+	void set( bool ready );
+
+	bool isReady() const { return ready; }
+    };
+}
+
+#endif
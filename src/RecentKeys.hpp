@@ -0,0 +1,133 @@
+#ifndef __AGGREGATOR_RECENTKEYS_HPP__
+#define __AGGREGATOR_RECENTKEYS_HPP__
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+namespace aggregator
+{
+    /** Set of the most recently inserted keys, up to a fixed count.
+     *
+     * The keys are kept in insertion order in a ring, and indexed by a
+     * small open addressing hash table. Inserting a key evicts the oldest
+     * one once the set is full. Lookups and insertions are constant time
+     * and do not allocate.
+     */
+    class RecentKeys
+    {
+	/** the keys in insertion order */
+	std::vector<uint64_t> ring;
+	size_t oldest;
+	size_t count;
+	/** hash table with linear probing, at most half full */
+	std::vector<uint64_t> slots;
+	std::vector<bool> used;
+	size_t mask;
+
+	size_t home( uint64_t key ) const
+	{
+	    return (key * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+	}
+
+	/** @return the slot of the key, or of the free slot where it would
+	 * be inserted */
+	size_t find( uint64_t key ) const
+	{
+	    size_t i = home( key );
+	    while( used[i] && slots[i] != key )
+		i = (i + 1) & mask;
+	    return i;
+	}
+
+	/** removes the key from the hash table, moving the following keys
+	 * of the probe sequence back so that they stay reachable */
+	void erase( uint64_t key )
+	{
+	    size_t i = find( key );
+	    used[i] = false;
+	    for( size_t j = (i + 1) & mask; used[j]; j = (j + 1) & mask )
+	    {
+		// a key can fill the hole if its home slot is not in (i, j]
+		size_t h = home( slots[j] );
+		bool reachable = i < j ? (h > i && h <= j) : (h > i || h <= j);
+		if( reachable )
+		    continue;
+		slots[i] = slots[j];
+		used[i] = true;
+		used[j] = false;
+		i = j;
+	    }
+	}
+
+    public:
+	/** @param capacity - count of keys that are remembered. The set is
+	 *      disabled if it is zero
+	 */
+	explicit RecentKeys( size_t capacity = 0 )
+	    : oldest( 0 ), count( 0 ), mask( 0 )
+	{
+	    setCapacity( capacity );
+	}
+
+	/** changes the count of remembered keys, forgetting all keys */
+	void setCapacity( size_t capacity )
+	{
+	    ring.assign( capacity, 0 );
+	    size_t size = 1;
+	    while( size < 2 * capacity )
+		size *= 2;
+	    slots.assign( capacity ? size : 0, 0 );
+	    used.assign( capacity ? size : 0, false );
+	    mask = size - 1;
+	    oldest = 0;
+	    count = 0;
+	}
+
+	size_t capacity() const { return ring.size(); }
+	size_t size() const { return count; }
+
+	bool contains( uint64_t key ) const
+	{
+	    return !ring.empty() && used[find( key )];
+	}
+
+	/** adds a key, evicting the oldest key if the set is full
+	 *
+	 * @return false if the key is already in the set, in which case it
+	 *      is not added again
+	 */
+	bool insert( uint64_t key )
+	{
+	    if( ring.empty() )
+		return true;
+
+	    size_t slot = find( key );
+	    if( used[slot] )
+		return false;
+
+	    if( count == ring.size() )
+	    {
+		erase( ring[oldest] );
+		ring[oldest] = key;
+		oldest = (oldest + 1) % ring.size();
+		slot = find( key );
+	    }
+	    else
+		ring[(oldest + count++) % ring.size()] = key;
+
+	    slots[slot] = key;
+	    used[slot] = true;
+	    return true;
+	}
+
+	void clear()
+	{
+	    std::fill( used.begin(), used.end(), false );
+	    oldest = 0;
+	    count = 0;
+	}
+    };
+}
+
+#endif
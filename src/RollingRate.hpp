@@ -0,0 +1,81 @@
+#ifndef __AGGREGATOR_ROLLINGRATE_HPP__
+#define __AGGREGATOR_ROLLINGRATE_HPP__
+
+#include <base/Time.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace aggregator
+{
+    /** Rate of events in data time, computed incrementally from an
+     * exponential moving average of the time between two events. The
+     * mean absolute deviation of that time is kept as well, as jitter.
+     *
+     * Updates and queries are constant time and do not allocate.
+     */
+    class RollingRate
+    {
+	base::Time last;
+	double interval;
+	double jitter;
+	size_t count;
+	double weight;
+
+    public:
+	/** @param weight - weight of a new interval in the moving averages
+	 */
+	explicit RollingRate( double weight = 0.1 )
+	    : interval( 0 ), jitter( 0 ), count( 0 ), weight( weight ) {}
+
+	/** adds an event at the given time. Events that are older than the
+	 * previous one are counted as happening at the same time.
+	 */
+	void update( const base::Time &time )
+	{
+	    if( !last.isNull() )
+	    {
+		double dt = std::max( 0.0, (time - last).toSeconds() );
+		if( count == 0 )
+		    interval = dt;
+		else
+		{
+		    jitter += weight * (fabs( dt - interval ) - jitter);
+		    interval += weight * (dt - interval);
+		}
+		count++;
+	    }
+	    if( time > last )
+		last = time;
+	}
+
+	/** @return the rate in Hz at the given time. The rate decreases once
+	 * no event happened for longer than the average interval. It is
+	 * zero until two events have been seen.
+	 */
+	double getRate( const base::Time &now ) const
+	{
+	    if( count == 0 )
+		return 0;
+	    double current = std::max( interval, (now - last).toSeconds() );
+	    return current > 0 ? 1.0 / current : 0;
+	}
+
+	/** @return the mean absolute deviation of the time between two
+	 * events, in seconds
+	 */
+	double getJitter() const
+	{
+	    return jitter;
+	}
+
+	void reset()
+	{
+	    last = base::Time();
+	    interval = 0;
+	    jitter = 0;
+	    count = 0;
+	}
+    };
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef __AGGREGATOR_SEQLOCK_HPP__
+#define __AGGREGATOR_SEQLOCK_HPP__
+
+#include <boost/atomic.hpp>
+
+namespace aggregator
+{
+    /** Publishes a copy of a value from a single writer thread to any number
+     * of reader threads, without locks.
+     *
+     * The writer never waits. A reader copies the value and retries if the
+     * writer modified it in the meantime, so it only ever waits for the
+     * duration of a single write.
+     *
+     * T must be a plain data type: readers may copy it while it gets
+     * written, and discard the result afterwards.
+     */
+    template <class T>
+    class SeqLock
+    {
+	/** odd while a write is in progress */
+	boost::atomic<unsigned int> sequence;
+	T value;
+
+    public:
+	SeqLock()
+	    : sequence( 0 ), value() {}
+
+	SeqLock( const SeqLock &other )
+	    : sequence( 0 ), value( other.read() ) {}
+
+	SeqLock& operator=( const SeqLock &other )
+	{
+	    write( other.read() );
+	    return *this;
+	}
+
+	/** publishes a new value. Must only be called from one thread
+	 */
+	void write( const T &new_value )
+	{
+	    unsigned int seq = sequence.load( boost::memory_order_relaxed );
+	    sequence.store( seq + 1, boost::memory_order_relaxed );
+	    boost::atomic_thread_fence( boost::memory_order_release );
+	    value = new_value;
+	    sequence.store( seq + 2, boost::memory_order_release );
+	}
+
+	/** copies the last published value into \c result
+	 *
+	 * @result - false if a write was in progress, in which case \c result
+	 *           is not valid
+	 */
+	bool tryRead( T &result ) const
+	{
+	    unsigned int before = sequence.load( boost::memory_order_acquire );
+	    if( before & 1 )
+		return false;
+	    result = value;
+	    boost::atomic_thread_fence( boost::memory_order_acquire );
+	    return sequence.load( boost::memory_order_relaxed ) == before;
+	}
+
+	/** returns the last published value
+	 */
+	T read() const
+	{
+	    T result;
+	    while( !tryRead( result ) ) {}
+	    return result;
+	}
+    };
+}
+
+#endif
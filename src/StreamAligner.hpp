@@ -8,39 +8,235 @@
 #include <algorithm>
 #include <boost/function.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <boost/type_traits/integral_constant.hpp>
 #include <stdexcept> 
 #include <iostream>
 #include <aggregator/StreamAlignerStatus.hpp>
+#include <aggregator/MemoryResource.hpp>
+#include <aggregator/ByteRingBuffer.hpp>
+#include <aggregator/CompressedSampleBuffer.hpp>
+#include <aggregator/RollingRate.hpp>
+#include <aggregator/LatencyHistogram.hpp>
+#include <aggregator/RecentKeys.hpp>
+#include <aggregator/ReadinessNotifier.hpp>
+#include <aggregator/DetermineSampleTimestamp.hpp>
+#if __cplusplus >= 201103L
+#include <memory>
+#include <type_traits>
+#include <utility>
+#endif
+
+/** Define AGGREGATOR_DISABLE_STATUS to compile out the counters and times of
+ * the stream status that are updated for each sample. The status then only
+ * reports the configuration and the buffer fill of the streams.
+ */
+#ifdef AGGREGATOR_DISABLE_STATUS
+#define AGGREGATOR_STATUS_UPDATE(statement)
+#else
+#define AGGREGATOR_STATUS_UPDATE(statement) statement
+#endif
 
 namespace aggregator {
 
+    /** Accumulator of a reduction stream for numeric samples, see
+     * StreamAligner::registerReductionStream():
+     *
+     * <code>
+     * aligner.registerReductionStream<double, ReductionSummary<double> >(
+     *	    &ReductionSummary<double>::fold, ReductionSummary<double>(),
+     *	    base::Time::fromMilliseconds(10), callback, 4 );
+     * </code>
+     */
+    template <class T> struct ReductionSummary
+    {
+	T min;
+	T max;
+	/** the last sample pushed into the bucket */
+	T last;
+	double sum;
+	size_t count;
+
+	ReductionSummary()
+	    : min(), max(), last(), sum( 0 ), count( 0 ) {}
+
+	double mean() const { return count ? sum / count : 0; }
+
+	static void fold( const base::Time &ts, const T &value, ReductionSummary<T> &summary )
+	{
+	    if( !summary.count || value < summary.min )
+		summary.min = value;
+	    if( !summary.count || summary.max < value )
+		summary.max = value;
+	    summary.last = value;
+	    summary.sum += value;
+	    summary.count++;
+	}
+    };
+
     class StreamAligner
     {
+	/** gives the key of a sample for the duplicate filter of a stream,
+	 * see setDuplicateFilter()
+	 */
+	struct DuplicateKeyBase
+	{
+	    virtual ~DuplicateKeyBase() {}
+	};
+
+	template <class T> struct DuplicateKey : public DuplicateKeyBase
+	{
+	    boost::function<uint64_t (const T&)> key;
+
+	    explicit DuplicateKey( const boost::function<uint64_t (const T&)> &key )
+		: key( key ) {}
+	};
+
 	class StreamBase
 	{
 	    friend class StreamAligner;
 	    public:
-		StreamBase() : active( true ) {}
-		virtual ~StreamBase() {}
-		virtual base::Time pop() = 0;
-		virtual bool hasData() const = 0;
+		StreamBase() : active( true ), input_stage( false ), memory_resource( 0 ), memory_size( 0 ), memory_alignment( 0 ),
+			       has_budget( false ), violations( 0 ), tracks_arrival( false ), duplicate_key( 0 ) {}
+		virtual ~StreamBase() { delete duplicate_key; }
+		virtual base::Time pop( size_t cursor ) = 0;
+		virtual void skip( size_t cursor ) = 0;
+		virtual bool hasData( size_t cursor ) const = 0;
 		virtual int getPriority() const = 0;
-		virtual base::Time latestTimeStamp() const = 0;
+		virtual base::Time latestTimeStamp( size_t cursor ) const = 0;
 		virtual base::Time latestDataTime() const = 0;
-		virtual base::Time earliestDataTime() const = 0;
+		virtual base::Time earliestDataTime( size_t cursor ) const = 0;
 		virtual const StreamStatus &getBufferStatus() const = 0;
 		virtual void copyState( const StreamBase& other ) = 0;
+		virtual void setCursorCount( size_t count ) = 0;
+		virtual bool isDynamicallySized() const = 0;
 		virtual void clear() = 0;
 
+		/** sets the parameters used by streams which size their buffer
+		 * automatically, see StreamAligner::setBufferSizeFactor()
+		 */
+		virtual void setBufferSizing( const base::Time &timeout, double factor, bool resizable ) {}
+
+		/** enables or disables the recording of the arrival time of
+		 * each buffered sample, see recordArrival()
+		 *
+		 * @param now - arrival time used for the samples that are
+		 *      already buffered
+		 */
+		virtual void setArrivalTracking( bool enable, const base::Time &now )
+		{
+		    if( enable )
+			throw std::runtime_error("stream " + status.name + " can not record the arrival time of its samples");
+		}
+
+		/** records the arrival time of the sample that has just been
+		 * added to the stream
+		 */
+		virtual void recordArrival( const base::Time &time ) {}
+
+		/** stores the samples the input stage is still accumulating,
+		 * see StreamAligner::flushStream()
+		 *
+		 * @result - true if a sample got added to the buffer
+		 */
+		virtual bool flushInput() { return false; }
+
 		bool isActive() const { return active; }
 		void setActive( bool active ) { this->active = active; }
+
+		/** true if the samples pushed into the stream go through a
+		 * StreamInput instead of being stored directly
+		 */
+		bool hasInputStage() const { return input_stage; }
 		
 		friend std::ostream &operator<<(std::ostream &stream, const aggregator::StreamAligner::StreamBase &base);
 		
 	    protected:
+		/** streams own their duplicate key, and are not copied */
+		StreamBase( const StreamBase& );
+
 		mutable StreamStatus status;
 		/** marks a stream as active or inactive. All streams are active by default. */
 		bool active;
+		bool input_stage;
+		/** the resource the stream object has been allocated from, with
+		 * the size and alignment of the allocation
+		 */
+		MemoryResource *memory_resource;
+		size_t memory_size;
+		size_t memory_alignment;
+		/** rates of the received, processed and dropped samples */
+		RollingRate input_rate;
+		RollingRate processed_rate;
+		RollingRate drop_rate;
+		/** arrival lateness of the samples, see
+		 * StreamAligner::enableLatenessTracking() */
+		LatencyHistogram lateness;
+
+		/** latency budget, see StreamAligner::setLatencyBudget() */
+		bool has_budget;
+		base::Time lag_budget;
+		base::Time residence_budget;
+		/** time of the sample for which the last alarm was raised */
+		base::Time last_alarm;
+		/** count of violations since the last alarm */
+		size_t violations;
+		/** true if the arrival times of the samples are recorded */
+		bool tracks_arrival;
+		/** arrival time of the sample given out by the last pop() */
+		base::Time popped_arrival;
+		/** keys of the recently pushed samples, see
+		 * StreamAligner::setDuplicateFilter(). Disabled if empty */
+		RecentKeys recent_keys;
+		/** key of the samples for the duplicate filter, the timestamp is
+		 * used if null */
+		DuplicateKeyBase *duplicate_key;
+
+		/** resets the counters, times and rates of the status, used by
+		 * clear()
+		 */
+		void clearStatus()
+		{
+		    status.latest_sample_time = base::Time();
+		    status.latest_data_time = base::Time();
+		    status.samples_received = 0;
+		    status.samples_processed = 0;
+		    status.samples_dropped_buffer_full = 0;
+		    status.samples_dropped_late_arriving = 0;
+		    status.samples_backward_in_time = 0;
+		    status.samples_filtered = 0;
+		    status.samples_duplicate = 0;
+		    status.buffer_fill = 0;
+		    status.active = true;
+		    input_rate.reset();
+		    processed_rate.reset();
+		    drop_rate.reset();
+		    lateness.clear();
+		    status.samples_over_budget = 0;
+		    last_alarm = base::Time();
+		    violations = 0;
+		}
+
+		/** fills the rates and the lateness percentiles of the status,
+		 * the rates being evaluated at the given time */
+		void updateStatistics( const base::Time &now ) const
+		{
+		    status.input_rate = input_rate.getRate( now );
+		    status.processed_rate = processed_rate.getRate( now );
+		    status.drop_rate = drop_rate.getRate( now );
+		    status.jitter = input_rate.getJitter();
+		    status.lateness_median = lateness.getPercentile( 0.5 );
+		    status.lateness_p90 = lateness.getPercentile( 0.9 );
+		    status.lateness_p99 = lateness.getPercentile( 0.99 );
+		    status.lateness_max = lateness.getMaximum();
+		}
+
+		void copyStatistics( const StreamBase &other )
+		{
+		    input_rate = other.input_rate;
+		    processed_rate = other.processed_rate;
+		    drop_rate = other.drop_rate;
+		    lateness = other.lateness;
+		}
 	};
 
         public:
@@ -48,41 +244,166 @@ namespace aggregator {
 	{
 	public:
 	    typedef boost::function<void (const base::Time &ts, const T &value)> callback_t;
+	    /** callback which may take the sample over, e.g. by swapping it or
+	     * moving it out. The sample is destroyed after the call.
+	     */
+	    typedef boost::function<void (const base::Time &ts, T &value)> move_callback_t;
 
 	protected:
 	    typedef std::pair<base::Time,T> item;
-	    boost::circular_buffer<item> buffer;
+	    /** whether samples can be copied. Samples of move-only types like
+	     * std::unique_ptr can only be given to the last reading cursor,
+	     * and the state of their stream can not be copied.
+	     */
+#if __cplusplus >= 201103L
+	    typedef boost::integral_constant<bool, std::is_copy_constructible<T>::value> copyable;
+#else
+	    typedef boost::true_type copyable;
+#endif
+	    /** the timestamps and the samples are kept in two rings of the
+	     * same capacity, so that the operations on the time only touch
+	     * the timestamps.
+	     */
+	    boost::circular_buffer<base::Time, ResourceAllocator<base::Time> > times;
+	    boost::circular_buffer<T, ResourceAllocator<T> > samples;
+	    /** arrival times of the samples, which are only recorded while
+	     * tracks_arrival is set */
+	    boost::circular_buffer<base::Time, ResourceAllocator<base::Time> > arrivals;
 	    size_t bufferSize;
-	    callback_t callback;
+	    /** the callbacks of the read cursors, indexed by cursor */
+	    std::vector<callback_t> callbacks;
+	    /** the move callbacks of the read cursors, used instead of the
+	     * callbacks when set */
+	    std::vector<move_callback_t> moveCallbacks;
+	    /** count of samples at the front of the buffer that have already
+	     * been consumed by each of the read cursors. Samples are released
+	     * once all cursors consumed them.
+	     */
+	    std::vector<size_t> cursors;
 	    base::Time period; 
 	    base::Time lastTime;
 	    int priority;
 
+	    /** true if the buffer size is derived from the timeout and the
+	     * sample period. See StreamAligner::setBufferSizeFactor()
+	     */
+	    bool autoSize;
+	    /** false if the buffer must not be reallocated, e.g. in real-time
+	     * mode */
+	    bool resizable;
+	    double sizingFactor;
+	    double sizingTimeout;
+	    /** the period given at registration, which is used until enough
+	     * samples have been received to measure it
+	     */
+	    double declaredPeriod;
+	    /** exponential moving average of the time between two samples */
+	    double measuredPeriod;
+	    size_t measuredCount;
+
+	    /** count of sample intervals that are needed before the measured
+	     * period is used for the buffer size */
+	    static const size_t MIN_PERIOD_MEASUREMENTS = 10;
+	    /** the buffer size is re-evaluated each time this many samples
+	     * have been received */
+	    static const size_t SIZING_INTERVAL = 16;
+
+	    /** adapts the capacity of an automatically sized buffer to the
+	     * current timeout and sample period, without losing data.
+	     *
+	     * The buffer grows as soon as it is too small, and shrinks only
+	     * once it is more than twice as large as needed.
+	     */
+	    void adaptBufferSize()
+	    {
+		if( !autoSize || !resizable )
+		    return;
+
+		// until the period is measured reliably, only use the
+		// measurements if they show that the buffer is too small
+		double samplePeriod = declaredPeriod;
+		if( measuredCount >= MIN_PERIOD_MEASUREMENTS || (measuredCount > 0 && measuredPeriod < declaredPeriod) )
+		    samplePeriod = measuredPeriod;
+		if( samplePeriod <= 0 )
+		    return;
+
+		size_t target = std::max( 1.0, sizingFactor * ceil( sizingTimeout / samplePeriod ) );
+		size_t capacity = times.capacity();
+		if( target > capacity || 2 * target < capacity )
+		{
+		    setCapacity( std::max( target, times.size() ) );
+		    bufferSize = times.capacity();
+		}
+	    }
+
+	    void setCapacity( size_t capacity )
+	    {
+		times.set_capacity( capacity );
+		samples.set_capacity( capacity );
+		if( tracks_arrival )
+		    arrivals.set_capacity( capacity );
+		status.buffer_size = capacity;
+	    }
+
+	    /** @return true if all other cursors already consumed the next
+	     * sample of the given cursor
+	     */
+	    bool isLastReader( size_t cursor ) const
+	    {
+		for(size_t i=0;i<cursors.size();i++)
+		{
+		    if( i != cursor && cursors[i] <= cursors[cursor] )
+			return false;
+		}
+		return true;
+	    }
+
+	    /** removes the samples from the buffer that have been consumed by
+	     * all cursors
+	     */
+	    void release()
+	    {
+		size_t consumed = *std::min_element( cursors.begin(), cursors.end() );
+		if( !consumed )
+		    return;
+
+		for(size_t i=0;i<cursors.size();i++)
+		    cursors[i] -= consumed;
+		times.erase_begin( consumed );
+		samples.erase_begin( consumed );
+		if( tracks_arrival )
+		    arrivals.erase_begin( consumed );
+		AGGREGATOR_STATUS_UPDATE( status.samples_processed += consumed; )
+	    }
+
 	public:
-	    Stream( callback_t callback, size_t bufferSize, base::Time period, int priority, const std::string &name )
-		: bufferSize( bufferSize ), callback(callback), period(period), lastTime(base::Time::fromSeconds(0)), priority(priority)
+	    /** @param resource - the memory resource for the buffer. The
+	     *      default resource is used if it is null.
+	     */
+	    Stream( callback_t callback, size_t bufferSize, base::Time period, int priority, const std::string &name, MemoryResource *resource = 0 )
+		: times( ResourceAllocator<base::Time>( resource ) ), samples( ResourceAllocator<T>( resource ) ), arrivals( ResourceAllocator<base::Time>( resource ) ), bufferSize( bufferSize ), callbacks(1, callback), moveCallbacks(1), cursors(1, 0), period(period), lastTime(base::Time::fromSeconds(0)), priority(priority),
+		  autoSize(false), resizable(true), sizingFactor(0), sizingTimeout(0), declaredPeriod(0), measuredPeriod(0), measuredCount(0)
             {
                 status.name = name;
 		status.priority = priority;
 
                 if (bufferSize > 0)
-                    buffer.set_capacity( bufferSize );
+                    setCapacity( bufferSize );
                 else
                 {
                     // initial size, will be reallocated at runtime
-                    buffer.set_capacity( 20 );
+                    setCapacity( 20 );
                 }
-                status.buffer_size = buffer.capacity();
             }
 
 	    virtual ~Stream() {};
 
 	    bool getNextSample(item &sample) const
 	    {
-		if(buffer.empty())
+		if(!hasData(0))
 		    return false;
 		
-		sample = buffer.front();
+		sample = item( times[cursors[0]], samples[cursors[0]] );
 		return true;
 	    }
 
@@ -91,11 +412,78 @@ namespace aggregator {
 		return priority;
 	    }
 
+	    /** replaces the callback that is called for samples going out of
+	     * this stream through the given read cursor
+	     */
+	    void setCallback( callback_t callback, size_t cursor = 0 )
+	    {
+		callbacks.at(cursor) = callback;
+		moveCallbacks.at(cursor) = move_callback_t();
+	    }
+
+	    /** replaces the callback of the given read cursor by a callback
+	     * that may take the samples over. 
+	     *
+	     * Only the last cursor that reads a sample gets the buffered
+	     * sample itself, the others are given a copy.
+	     */
+	    void setMoveCallback( move_callback_t callback, size_t cursor = 0 )
+	    {
+		moveCallbacks.at(cursor) = callback;
+		callbacks.at(cursor) = callback_t();
+	    }
+
+	    virtual bool isDynamicallySized() const
+	    {
+		return bufferSize == 0;
+	    }
+
+	    virtual void setCursorCount( size_t count )
+	    {
+		callbacks.resize( count );
+		moveCallbacks.resize( count );
+		cursors.resize( count, 0 );
+	    }
+
+	    /** Lets the stream size its buffer from the timeout and the
+	     * measured sample period.
+	     *
+	     * @param period - the expected sample period, used until the
+	     *      period has been measured
+	     */
+	    void setAutoSize( const base::Time &period )
+	    {
+		autoSize = true;
+		declaredPeriod = period.toSeconds();
+	    }
+
+	    virtual void setBufferSizing( const base::Time &timeout, double factor, bool resizable )
+	    {
+		sizingTimeout = timeout.toSeconds();
+		sizingFactor = factor;
+		this->resizable = resizable;
+		adaptBufferSize();
+	    }
+
+	    virtual void setArrivalTracking( bool enable, const base::Time &now )
+	    {
+		tracks_arrival = enable;
+		if( enable )
+		    arrivals.assign( times.capacity(), times.size(), now );
+		else
+		    arrivals.set_capacity( 0 );
+	    }
+
+	    virtual void recordArrival( const base::Time &time )
+	    {
+		arrivals.push_back( time );
+	    }
+
 	    virtual const StreamStatus &getBufferStatus() const
 	    {
-		status.buffer_fill = buffer.size();
+		status.buffer_fill = times.size();
 		status.latest_data_time = latestDataTime();
- 		status.earliest_data_time = earliestDataTime();
+ 		status.earliest_data_time = times.empty() ? base::Time() : times.front();
 		status.active = isActive();
 		return status;
 	    }
@@ -105,63 +493,160 @@ namespace aggregator {
 		const Stream<T> &stream(dynamic_cast<const Stream<T>& >(other));
 		
 		lastTime = stream.lastTime;
-		buffer = stream.buffer;
+		copyBuffer( stream, copyable() );
 		bufferSize = stream.bufferSize;
+		cursors = stream.cursors;
 		status = stream.status; 
 	    }
 
-	    void push(const base::Time &ts, const T &data ) 
+	    /** @return false if the sample got dropped because it was older
+	     * than the previous sample
+	     */
+	    bool push(const base::Time &ts, const T &data ) 
 	    { 
+		if( !prepareSample( ts ) )
+		    return false;
+		times.push_back( ts );
+		samples.push_back( data );
+		return true;
+	    }
+
+#if __cplusplus >= 201103L
+	    /** @overload moves the sample into the buffer */
+	    bool push( const base::Time &ts, T &&data )
+	    {
+		if( !prepareSample( ts ) )
+		    return false;
+		times.push_back( ts );
+		samples.push_back( std::move( data ) );
+		return true;
+	    }
+#endif
+
+	protected:
+	    void copyBuffer( const Stream<T> &other, boost::true_type )
+	    {
+		times = other.times;
+		samples = other.samples;
+		if( tracks_arrival && other.tracks_arrival )
+		    arrivals = other.arrivals;
+		else if( tracks_arrival )
+		    arrivals.assign( times.capacity(), times.size(), base::Time() );
+	    }
+
+	    void copyBuffer( const Stream<T> &other, boost::false_type )
+	    {
+		throw std::runtime_error("copyState: the samples of stream " + status.name + " can not be copied");
+	    }
+
+	    void moveCopy( size_t cursor, const base::Time &ts, const T &sample, boost::true_type )
+	    {
+		T copy( sample );
+		moveCallbacks[cursor]( ts, copy );
+	    }
+
+	    void moveCopy( size_t cursor, const base::Time &ts, const T &sample, boost::false_type )
+	    {
+		throw std::runtime_error("the samples of stream " + status.name + " can not be copied for several read cursors");
+	    }
+
+	    /** checks the time of a new sample and makes room for it in the
+	     * buffer
+	     *
+	     * @result - false if the sample has to be dropped
+	     */
+	    bool prepareSample( const base::Time &ts )
+	    {
 		if(ts < lastTime)
 		{
-		    status.samples_backward_in_time++;
-		    return;
+		    AGGREGATOR_STATUS_UPDATE( status.samples_backward_in_time++; drop_rate.update( ts ); )
+		    return false;
+		}
+
+		if( autoSize && !lastTime.isNull() && ts > lastTime )
+		{
+		    double dt = (ts - lastTime).toSeconds();
+		    if( measuredCount == 0 )
+			measuredPeriod = dt;
+		    else
+			measuredPeriod += 0.1 * (dt - measuredPeriod);
+		    measuredCount++;
+
+		    if( measuredCount % SIZING_INTERVAL == 0 || times.full() )
+			adaptBufferSize();
 		}
 		
 		lastTime = ts;
 
-		if (buffer.full())
+		if (times.full())
                 {
 		    if (bufferSize > 0)
 		    {
 		        // if the buffer is full, just use the behaviour of the circular
 		        // buffer: discard old data.
-		        status.samples_dropped_buffer_full++;
+		        AGGREGATOR_STATUS_UPDATE( status.samples_dropped_buffer_full++; drop_rate.update( ts ); )
+			for(size_t i=0;i<cursors.size();i++)
+			{
+			    if( cursors[i] > 0 )
+				cursors[i]--;
+			}
 		    }
 		    else
 		    {
-		        buffer.set_capacity(buffer.capacity() * 2);
-			status.buffer_size = buffer.capacity();
+			setCapacity( times.capacity() * 2 );
 		    }
 		}
-                buffer.push_back( std::make_pair(ts, data) ); 
+		return true;
 	    }
 
-	    /** take the last item of the stream queue and 
-	     * call the callback 
+	public:
+
+	    /** take the next item of the stream queue for the given cursor
+	     * and call the cursor's callback 
 	     */
-	    base::Time pop() 
+	    base::Time pop( size_t cursor ) 
 	    { 
-		if( hasData() )
+		if( hasData(cursor) )
 		{
-		    status.samples_processed++;
-		    base::Time ts = buffer.front().first;
-		    if(callback)
-			callback( ts, buffer.front().second );
-		    buffer.pop_front();
+		    base::Time ts = times[cursors[cursor]];
+		    T &next( samples[cursors[cursor]] );
+		    if( tracks_arrival )
+			popped_arrival = arrivals[cursors[cursor]];
+		    if(moveCallbacks[cursor])
+		    {
+			if( isLastReader( cursor ) )
+			    moveCallbacks[cursor]( ts, next );
+			else
+			    moveCopy( cursor, ts, next, copyable() );
+		    }
+		    else if(callbacks[cursor])
+			callbacks[cursor]( ts, next );
+		    cursors[cursor]++;
+		    release();
 		    return ts;
 		}
 
 		throw std::runtime_error("pop() called on stream with no data.");
 	    }
 
-	    bool hasData() const
-	    { return !buffer.empty(); }
+	    /** marks the newest sample as consumed by the given cursor,
+	     * without calling the callback. This is used for samples that
+	     * arrived too late for that cursor.
+	     */
+	    void skip( size_t cursor )
+	    {
+		assert( cursors[cursor] + 1 == times.size() );
+		cursors[cursor]++;
+		release();
+	    }
+
+	    bool hasData( size_t cursor ) const
+	    { return cursors[cursor] < times.size(); }
 
-	    base::Time latestTimeStamp() const
+	    base::Time latestTimeStamp( size_t cursor ) const
 	    {
-		if( hasData() )
-		    return buffer.front().first;
+		if( hasData(cursor) )
+		    return times[cursors[cursor]];
 		else 
 		    return lastTime + period;
 	    }
@@ -171,200 +656,1867 @@ namespace aggregator {
 		return lastTime;
 	    }
 	    
-	    virtual base::Time earliestDataTime() const
+	    virtual base::Time earliestDataTime( size_t cursor ) const
 	    {
-		if( hasData() )
-		    return buffer.front().first;
+		if( hasData(cursor) )
+		    return times[cursors[cursor]];
 		return base::Time();
 	    }
 	    
 	    virtual void clear()
 	    {	
 		lastTime = base::Time();
-		buffer.clear();
-		
-		status.latest_sample_time = base::Time();
-		status.latest_data_time = base::Time();
-		status.samples_dropped_buffer_full = 0;
-		status.samples_dropped_late_arriving = 0;
-		status.buffer_fill = 0;
-		status.active = true;
+		times.clear();
+		samples.clear();
+		arrivals.clear();
+		std::fill( cursors.begin(), cursors.end(), 0 );
+		measuredPeriod = 0;
+		measuredCount = 0;
+		clearStatus();
 	    };
 	};
 
-	static bool compareStreams( const StreamBase* b1, const StreamBase* b2 )
+	/** Input interface of streams which do not store the samples that are
+	 * pushed into them as they are, see registerTransformStream()
+	 */
+	template <class T> class StreamInput
 	{
-	    if(!b1)
-		return false;
-	    
-	    if(!b2)
-		return true;
-	    
-	    const base::Time &ts1( b1->latestTimeStamp() );
-	    const base::Time &ts2( b2->latestTimeStamp() );
+	public:
+	    virtual ~StreamInput() {}
+
+	    /** @result - false if the sample was not stored in the stream
+	     */
+	    virtual bool pushInput( const base::Time &ts, const T &data ) = 0;
+	};
+
+	/** Stream which runs a transform stage on the samples of type T
+	 * pushed into it, and buffers the results of type U.
+	 *
+	 * The stage runs in push(), i.e. in the thread of the producer.
+	 */
+	template <class T, class U> class TransformStream : public Stream<U>, public StreamInput<T>
+	{
+	public:
+	    /** Transform stage. It writes the transformed sample into output
+	     * and returns true, or returns false to drop the sample.
+	     */
+	    typedef boost::function<bool (const base::Time &ts, const T &input, U &output)> transform_t;
+
+	protected:
+	    transform_t transform;
+	    /** the result of the transform stage, which is then copied into
+	     * the buffer
+	     */
+	    U output;
 
-	    if(ts1 == ts2)
+	public:
+	    TransformStream( transform_t transform, typename Stream<U>::callback_t callback, size_t bufferSize, base::Time period, int priority, const std::string &name, MemoryResource *resource = 0 )
+		: Stream<U>( callback, bufferSize, period, priority, name, resource ), transform( transform )
 	    {
-		if(b1->hasData() && !b2->hasData())
-		    return true;
-		
-		if(!b1->hasData() && b2->hasData())
+		this->input_stage = true;
+	    }
+
+	    bool pushInput( const base::Time &ts, const T &data )
+	    {
+		if( !transform( ts, data, output ) )
+		{
+		    AGGREGATOR_STATUS_UPDATE( this->status.samples_filtered++; )
 		    return false;
-		
-		return b1->getPriority() < b2->getPriority();
+		}
+		return this->push( ts, output );
 	    }
-	    
-	    return ts1 < ts2;
-	}
+	};
 
-	typedef std::vector<StreamBase*> stream_vector;
-	stream_vector streams;
-	base::Time timeout;
+	/** Stream which folds the samples of type T pushed into it into one
+	 * accumulator of type A per time bucket, and buffers the accumulators
+	 * of the closed buckets. See registerReductionStream().
+	 *
+	 * Buckets are aligned on multiples of their width. A bucket closes
+	 * when the first sample of a later bucket is pushed, or when it is
+	 * flushed, and is buffered with the time of its end.
+	 */
+	template <class T, class A> class ReductionStream : public Stream<A>, public StreamInput<T>
+	{
+	public:
+	    /** Fold stage. It adds the sample to the accumulator of its bucket.
+	     */
+	    typedef boost::function<void (const base::Time &ts, const T &input, A &accumulator)> fold_t;
 
-	/** time of the last sample that came in */
-	base::Time latest_ts;
+	protected:
+	    fold_t fold;
+	    /** value of the accumulator at the beginning of a bucket */
+	    A initial;
+	    A accumulator;
+	    int64_t width;
+	    bool bucket_open;
+	    base::Time bucket_end;
+
+	    /** @return the end of the bucket the given time belongs to */
+	    base::Time getBucketEnd( const base::Time &ts ) const
+	    {
+		int64_t us = ts.toMicroseconds();
+		int64_t index = us / width;
+		if( us < 0 && us % width )
+		    index--;
+		return base::Time::fromMicroseconds( (index + 1) * width );
+	    }
 
-	/** time of the last sample that went out */
-	base::Time current_ts;
+	    bool closeBucket()
+	    {
+		bucket_open = false;
+		return this->push( bucket_end, accumulator );
+	    }
 
-	double buffer_size_factor;
+	public:
+	    ReductionStream( fold_t fold, const A &initial, base::Time width, typename Stream<A>::callback_t callback, size_t bufferSize, int priority, const std::string &name, MemoryResource *resource = 0 )
+		: Stream<A>( callback, bufferSize, width, priority, name, resource ), fold( fold ), initial( initial ), accumulator( initial ),
+		  width( width.toMicroseconds() ), bucket_open( false )
+	    {
+		this->input_stage = true;
+	    }
 
-	/** temporary object that gets returned by getStatus, 
-	 * in order to avoid dynamic allocation on each call
-	 */  
-	mutable StreamAlignerStatus status;
+	    /** @result - true if the sample closed a bucket, which got buffered
+	     */
+	    bool pushInput( const base::Time &ts, const T &data )
+	    {
+		base::Time end = getBucketEnd( ts );
+		bool closed = false;
+		if( bucket_open && end < bucket_end )
+		{
+		    // the bucket of the sample has already been closed
+		    AGGREGATOR_STATUS_UPDATE( this->status.samples_backward_in_time++; this->drop_rate.update( ts ); )
+		    return false;
+		}
+		else if( bucket_open && bucket_end < end )
+		    closed = closeBucket();
+
+		if( !bucket_open )
+		{
+		    accumulator = initial;
+		    bucket_end = end;
+		    bucket_open = true;
+		}
+		fold( ts, data, accumulator );
+		return closed;
+	    }
+
+	    virtual bool flushInput()
+	    {
+		if( !bucket_open )
+		    return false;
+		return closeBucket();
+	    }
+
+	    virtual void copyState( const StreamBase& other )
+	    {
+		Stream<A>::copyState( other );
+		const ReductionStream<T,A> *stream = dynamic_cast<const ReductionStream<T,A>*>( &other );
+		if( stream )
+		{
+		    accumulator = stream->accumulator;
+		    bucket_open = stream->bucket_open;
+		    bucket_end = stream->bucket_end;
+		}
+	    }
+
+	    virtual void clear()
+	    {
+		Stream<A>::clear();
+		bucket_open = false;
+	    }
+	};
+
+	/** Stream of variable-length packets, which are stored with their
+	 * timestamp and length in a fixed-size byte ring (see
+	 * ByteRingBuffer). Buffering a packet does not allocate, and the
+	 * memory used by the buffered packets is proportional to their size.
+	 *
+	 * The callbacks receive a view on the packet inside the ring, which is
+	 * only valid during the call.
+	 */
+	class PacketStream : public StreamBase
+	{
+	public:
+	    typedef boost::function<void (const base::Time &ts, const ByteSpan &packet)> callback_t;
+
+	protected:
+	    ByteRingBuffer buffer;
+	    /** the callbacks of the read cursors, indexed by cursor */
+	    std::vector<callback_t> callbacks;
+	    /** position in the buffer of the next packet of each read cursor */
+	    std::vector<uint64_t> cursors;
+	    base::Time period; 
+	    base::Time lastTime;
+	    int priority;
+
+	    /** removes the packets from the buffer that have been consumed by
+	     * all cursors
+	     */
+	    void release()
+	    {
+		uint64_t consumed = *std::min_element( cursors.begin(), cursors.end() );
+		while( !buffer.empty() && buffer.begin() < consumed )
+		{
+		    buffer.pop();
+		    AGGREGATOR_STATUS_UPDATE( status.samples_processed++; )
+		}
+	    }
+
+	public:
+	    /** @param bufferSize - size of the byte ring, in bytes
+	     */
+	    PacketStream( callback_t callback, size_t bufferSize, base::Time period, int priority, const std::string &name, MemoryResource *resource = 0 )
+		: buffer( bufferSize, resource ), callbacks(1, callback), cursors(1, 0), period(period), priority(priority)
+	    {
+		status.name = name;
+		status.priority = priority;
+		status.buffer_size = buffer.capacity();
+	    }
+
+	    void setCallback( callback_t callback, size_t cursor = 0 )
+	    {
+		callbacks.at(cursor) = callback;
+	    }
+
+	    virtual void setCursorCount( size_t count )
+	    {
+		callbacks.resize( count );
+		cursors.resize( count, buffer.begin() );
+	    }
+
+	    virtual bool isDynamicallySized() const
+	    {
+		return false;
+	    }
+
+	    virtual int getPriority() const
+	    {
+		return priority;
+	    }
+
+	    virtual const StreamStatus &getBufferStatus() const
+	    {
+		status.buffer_fill = buffer.size();
+		status.latest_data_time = latestDataTime();
+		status.earliest_data_time = buffer.empty() ? base::Time() : buffer.time( buffer.begin() );
+		status.active = isActive();
+		return status;
+	    }
+
+	    virtual void copyState( const StreamBase& other )
+	    {
+		const PacketStream &stream(dynamic_cast<const PacketStream& >(other));
+
+		lastTime = stream.lastTime;
+		buffer = stream.buffer;
+		cursors = stream.cursors;
+		status = stream.status; 
+	    }
+
+	    /** @return false if the packet got dropped, because it was older
+	     * than the previous packet or larger than the buffer
+	     */
+	    bool push( const base::Time &ts, const uint8_t *data, size_t size )
+	    {
+		if(ts < lastTime)
+		{
+		    AGGREGATOR_STATUS_UPDATE( status.samples_backward_in_time++; drop_rate.update( ts ); )
+		    return false;
+		}
+
+		if(!buffer.fits( size ))
+		{
+		    AGGREGATOR_STATUS_UPDATE( status.samples_dropped_buffer_full++; drop_rate.update( ts ); )
+		    return false;
+		}
+
+		lastTime = ts;
+
+		// the ring drops the oldest packets if there is not enough
+		// space left
+#ifdef AGGREGATOR_DISABLE_STATUS
+		buffer.push( ts, data, size );
+#else
+		size_t dropped = buffer.push( ts, data, size );
+		status.samples_dropped_buffer_full += dropped;
+		for(size_t i=0;i<dropped;i++)
+		    drop_rate.update( ts );
+#endif
+		for(size_t i=0;i<cursors.size();i++)
+		{
+		    if( cursors[i] < buffer.begin() )
+			cursors[i] = buffer.begin();
+		}
+		return true;
+	    }
+
+	    base::Time pop( size_t cursor )
+	    {
+		if( hasData(cursor) )
+		{
+		    uint64_t pos = cursors[cursor];
+		    base::Time ts = buffer.time( pos );
+		    if(callbacks[cursor])
+			callbacks[cursor]( ts, buffer.data( pos ) );
+		    cursors[cursor] = buffer.next( pos );
+		    release();
+		    return ts;
+		}
+
+		throw std::runtime_error("pop() called on stream with no data.");
+	    }
+
+	    void skip( size_t cursor )
+	    {
+		assert( buffer.next( cursors[cursor] ) == buffer.end() );
+		cursors[cursor] = buffer.end();
+		release();
+	    }
+
+	    bool hasData( size_t cursor ) const
+	    { return cursors[cursor] < buffer.end(); }
+
+	    base::Time latestTimeStamp( size_t cursor ) const
+	    {
+		if( hasData(cursor) )
+		    return buffer.time( cursors[cursor] );
+		else 
+		    return lastTime + period;
+	    }
+
+	    virtual base::Time latestDataTime() const
+	    {
+		return lastTime;
+	    }
+
+	    virtual base::Time earliestDataTime( size_t cursor ) const
+	    {
+		if( hasData(cursor) )
+		    return buffer.time( cursors[cursor] );
+		return base::Time();
+	    }
+
+	    virtual void clear()
+	    {
+		lastTime = base::Time();
+		buffer.clear();
+		std::fill( cursors.begin(), cursors.end(), buffer.end() );
+		clearStatus();
+	    }
+	};
+
+	/** Stream of numeric samples, which are stored compressed in a
+	 * CompressedSampleBuffer and decoded when they are given to the
+	 * callbacks. See registerCompressedStream().
+	 *
+	 * The samples are released from the buffer, and counted as processed,
+	 * a block at a time.
+	 */
+	template <class T> class CompressedStream : public StreamBase, public StreamInput<T>
+	{
+	public:
+	    typedef typename Stream<T>::callback_t callback_t;
+
+	protected:
+	    typedef CompressedSampleTraits<T> traits;
+
+	    CompressedSampleBuffer buffer;
+	    /** the callbacks of the read cursors, indexed by cursor */
+	    std::vector<callback_t> callbacks;
+	    /** position and decoder state of each read cursor */
+	    std::vector<CompressedSampleBuffer::Reader> cursors;
+	    /** the channels of the sample being pushed or decoded */
+	    std::vector<uint64_t> words;
+	    T sample;
+	    base::Time period; 
+	    base::Time lastTime;
+	    int priority;
+
+	    /** removes the blocks from the buffer that have been consumed by
+	     * all cursors
+	     */
+	    void release()
+	    {
+		uint64_t block = buffer.neededBlock( cursors[0] );
+		for(size_t i=1;i<cursors.size();i++)
+		    block = std::min( block, buffer.neededBlock( cursors[i] ) );
+		buffer.release( block );
+	    }
+
+	    /** counts the sample the given cursor just read as processed, if
+	     * all other cursors already read it. Samples stay in their block
+	     * until the whole block is released, so they are counted here
+	     * rather than in release()
+	     */
+	    void countProcessed( size_t cursor )
+	    {
+		const CompressedSampleBuffer::Reader &read( cursors[cursor] );
+		for(size_t i=0;i<cursors.size();i++)
+		{
+		    if( cursors[i].block < read.block || (cursors[i].block == read.block && cursors[i].index < read.index) )
+			return;
+		}
+		status.samples_processed++;
+	    }
+
+	    /** @return the count of samples of the given block, which holds
+	     * count samples, that all cursors have read */
+	    size_t deliveredInBlock( uint64_t block, size_t count ) const
+	    {
+		size_t delivered = count;
+		for(size_t i=0;i<cursors.size();i++)
+		{
+		    if( cursors[i].block == block )
+			delivered = std::min( delivered, cursors[i].index );
+		}
+		return delivered;
+	    }
+
+	public:
+	    /** @param bufferSize - memory of the compressed samples, in bytes
+	     */
+	    CompressedStream( callback_t callback, size_t bufferSize, base::Time period, int priority, const std::string &name, MemoryResource *resource = 0 )
+		: buffer( bufferSize, traits::channels, traits::coding, resource ), callbacks(1, callback), cursors(1, buffer.end()), words( traits::channels ), sample(), period(period), priority(priority)
+	    {
+		this->input_stage = true;
+		status.name = name;
+		status.priority = priority;
+		status.buffer_size = buffer.capacity();
+	    }
+
+	    void setCallback( callback_t callback, size_t cursor = 0 )
+	    {
+		callbacks.at(cursor) = callback;
+	    }
+
+	    virtual void setCursorCount( size_t count )
+	    {
+		callbacks.resize( count );
+		cursors.resize( count, buffer.end() );
+	    }
+
+	    virtual bool isDynamicallySized() const
+	    {
+		return false;
+	    }
+
+	    virtual int getPriority() const
+	    {
+		return priority;
+	    }
+
+	    virtual const StreamStatus &getBufferStatus() const
+	    {
+		status.buffer_fill = buffer.size();
+		status.latest_data_time = latestDataTime();
+		status.earliest_data_time = buffer.frontTime();
+		status.active = isActive();
+		return status;
+	    }
+
+	    virtual void copyState( const StreamBase& other )
+	    {
+		const CompressedStream<T> &stream(dynamic_cast<const CompressedStream<T>& >(other));
+
+		lastTime = stream.lastTime;
+		buffer = stream.buffer;
+		cursors = stream.cursors;
+		status = stream.status; 
+	    }
+
+	    /** @return false if the sample got dropped because it was older
+	     * than the previous sample
+	     */
+	    bool pushInput( const base::Time &ts, const T &data )
+	    {
+		if(ts < lastTime)
+		{
+		    AGGREGATOR_STATUS_UPDATE( status.samples_backward_in_time++; drop_rate.update( ts ); )
+		    return false;
+		}
+		lastTime = ts;
+
+		traits::toWords( data, &words[0] );
+		// the buffer drops its oldest block if it is full
+#ifdef AGGREGATOR_DISABLE_STATUS
+		buffer.push( ts, &words[0] );
+#else
+		size_t dropped = buffer.push( ts, &words[0] );
+		// the samples of the block that all cursors already read have
+		// been counted as processed
+		if( dropped )
+		    dropped -= deliveredInBlock( buffer.frontBlock() - 1, dropped );
+		status.samples_dropped_buffer_full += dropped;
+		for(size_t i=0;i<dropped;i++)
+		    drop_rate.update( ts );
+#endif
+		for(size_t i=0;i<cursors.size();i++)
+		{
+		    if( !buffer.isValid( cursors[i] ) )
+			buffer.begin( cursors[i] );
+		}
+		return true;
+	    }
+
+	    base::Time pop( size_t cursor )
+	    {
+		if( hasData(cursor) )
+		{
+		    base::Time ts = buffer.read( cursors[cursor], &words[0] );
+		    AGGREGATOR_STATUS_UPDATE( countProcessed( cursor ); )
+		    if(callbacks[cursor])
+		    {
+			traits::fromWords( &words[0], sample );
+			callbacks[cursor]( ts, sample );
+		    }
+		    release();
+		    return ts;
+		}
+
+		throw std::runtime_error("pop() called on stream with no data.");
+	    }
+
+	    void skip( size_t cursor )
+	    {
+		buffer.read( cursors[cursor], &words[0] );
+		AGGREGATOR_STATUS_UPDATE( countProcessed( cursor ); )
+		assert( buffer.atEnd( cursors[cursor] ) );
+		release();
+	    }
+
+	    bool hasData( size_t cursor ) const
+	    { return !buffer.atEnd( cursors[cursor] ); }
+
+	    base::Time latestTimeStamp( size_t cursor ) const
+	    {
+		if( hasData(cursor) )
+		    return buffer.peekTime( cursors[cursor] );
+		else 
+		    return lastTime + period;
+	    }
+
+	    virtual base::Time latestDataTime() const
+	    {
+		return lastTime;
+	    }
+
+	    virtual base::Time earliestDataTime( size_t cursor ) const
+	    {
+		if( hasData(cursor) )
+		    return buffer.peekTime( cursors[cursor] );
+		return base::Time();
+	    }
+
+	    virtual void clear()
+	    {
+		lastTime = base::Time();
+		buffer.clear();
+		std::fill( cursors.begin(), cursors.end(), buffer.end() );
+		clearStatus();
+	    }
+	};
+
+	/** Stream of periodic ticks, which are generated when they are
+	 * selected instead of being pushed.
+	 *
+	 * The ticks are at the multiples of the period, starting with the first
+	 * one not earlier than the first sample of the aligner. A tick is
+	 * available once the aligner received a sample which is not earlier
+	 * than the tick. The stream is inactive and has no buffer, so it never
+	 * makes the aligner wait.
+	 */
+	class TickStream : public StreamBase
+	{
+	public:
+	    typedef boost::function<void (const base::Time &ts)> callback_t;
+
+	protected:
+	    std::vector<callback_t> callbacks;
+	    /** count of ticks that have been given to each of the read cursors */
+	    std::vector<uint64_t> ticks;
+	    int64_t period;
+	    int priority;
+	    /** time of the first and of the latest sample of the aligner */
+	    const base::Time *first_time;
+	    const base::Time *latest_time;
+
+	    base::Time tickTime( size_t cursor ) const
+	    {
+		int64_t first = first_time->toMicroseconds();
+		int64_t index = first / period;
+		if( index * period < first )
+		    index++;
+		return base::Time::fromMicroseconds( (index + ticks[cursor]) * period );
+	    }
+
+	public:
+	    TickStream( callback_t callback, base::Time period, int priority, const std::string &name, const base::Time *first_time, const base::Time *latest_time )
+		: callbacks(1, callback), ticks(1, 0), period(period.toMicroseconds()), priority(priority),
+		  first_time(first_time), latest_time(latest_time)
+	    {
+		status.name = name;
+		status.priority = priority;
+		active = false;
+	    }
+
+	    void setCallback( callback_t callback, size_t cursor = 0 )
+	    {
+		callbacks.at(cursor) = callback;
+	    }
+
+	    base::Time pop( size_t cursor )
+	    {
+		if( hasData(cursor) )
+		{
+		    base::Time ts = tickTime( cursor );
+		    if( callbacks[cursor] )
+			callbacks[cursor]( ts );
+		    ticks[cursor]++;
+		    AGGREGATOR_STATUS_UPDATE( if( cursor == 0 ) status.samples_processed++; )
+		    return ts;
+		}
+
+		throw std::runtime_error("pop() called on stream with no data.");
+	    }
+
+	    void skip( size_t cursor )
+	    {
+		throw std::runtime_error("skip() called on a tick stream.");
+	    }
+
+	    bool hasData( size_t cursor ) const
+	    {
+		return !first_time->isNull() && tickTime( cursor ) <= *latest_time;
+	    }
+
+	    int getPriority() const
+	    {
+		return priority;
+	    }
+
+	    base::Time latestTimeStamp( size_t cursor ) const
+	    {
+		if( first_time->isNull() )
+		    return base::Time();
+		return tickTime( cursor );
+	    }
+
+	    virtual base::Time latestDataTime() const
+	    {
+		return *latest_time;
+	    }
+
+	    virtual base::Time earliestDataTime( size_t cursor ) const
+	    {
+		if( hasData(cursor) )
+		    return tickTime( cursor );
+		return base::Time();
+	    }
+
+	    virtual const StreamStatus &getBufferStatus() const
+	    {
+		status.latest_data_time = latestDataTime();
+		status.earliest_data_time = earliestDataTime( 0 );
+		status.active = isActive();
+		return status;
+	    }
+
+	    virtual void copyState( const StreamBase& other )
+	    {
+		const TickStream &stream(dynamic_cast<const TickStream& >(other));
+		ticks = stream.ticks;
+		status = stream.status;
+	    }
+
+	    virtual void setCursorCount( size_t count )
+	    {
+		callbacks.resize( count );
+		ticks.resize( count, ticks[0] );
+	    }
+
+	    virtual bool isDynamicallySized() const
+	    {
+		return false;
+	    }
+
+	    virtual void clear()
+	    {
+		std::fill( ticks.begin(), ticks.end(), 0 );
+		clearStatus();
+		status.active = false;
+	    }
+	};
+
+	/** orders streams by the time of the next sample of a given read
+	 * cursor
+	 */
+	struct CompareStreams
+	{
+	    size_t cursor;
+
+	    explicit CompareStreams( size_t cursor ) : cursor( cursor ) {}
+
+	    bool operator()( const StreamBase* b1, const StreamBase* b2 ) const
+	    {
+		if(!b1)
+		    return false;
+		
+		if(!b2)
+		    return true;
+		
+		const base::Time &ts1( b1->latestTimeStamp(cursor) );
+		const base::Time &ts2( b2->latestTimeStamp(cursor) );
+
+		if(ts1 == ts2)
+		{
+		    if(b1->hasData(cursor) && !b2->hasData(cursor))
+			return true;
+		    
+		    if(!b1->hasData(cursor) && b2->hasData(cursor))
+			return false;
+		    
+		    return b1->getPriority() < b2->getPriority();
+		}
+		
+		return ts1 < ts2;
+	    }
+	};
+
+	/** A read cursor replays the samples of all streams with its own
+	 * timeout and its own callbacks. Cursor 0 always exists and is the one
+	 * used by step(). The stream buffers are shared between all cursors.
+	 */
+	struct Cursor
+	{
+	    base::Time timeout;
+
+	    /** time of the last sample that went out */
+	    base::Time current_ts;
+
+	    /** count of samples that were too late for this cursor */
+	    size_t samples_dropped_late_arriving;
+
+	    explicit Cursor( base::Time timeout )
+		: timeout( timeout ), samples_dropped_late_arriving( 0 ) {}
+	};
+
+	typedef std::vector<StreamBase*> stream_vector;
+	stream_vector streams;
+
+	/** scratch copy of streams that step() sorts, so that it does not
+	 * need to allocate memory
+	 */
+	mutable stream_vector sorted_streams;
+
+	std::vector<Cursor> cursors;
+
+	/** time of the last sample that came in */
+	base::Time latest_ts;
+	/** time of the first sample that came in, from which the tick
+	 * streams start */
+	base::Time first_ts;
+
+	double buffer_size_factor;
+
+	/** true if the configuration is locked, see setRealtimeMode() */
+	bool realtime;
+
+	/** resource used for the streams which are registered without one */
+	MemoryResource *memory_resource;
+
+	/** readiness descriptor, see enableReadinessNotification() */
+	ReadinessNotifier *notifier;
+	int notifier_cursor;
+
+    public:
+	typedef boost::function<base::Time ()> arrival_clock_t;
+
+    protected:
+	/** clock giving the arrival time of the samples, used to record
+	 * their lateness. Lateness is not recorded if it is empty. */
+	arrival_clock_t arrival_clock;
+	base::Time arrival_offset;
+
+    public:
+	/** Description of a sample that exceeded the latency budget of its
+	 * stream, see setLatencyBudget()
+	 */
+	struct LatencyViolation
+	{
+	    /** index of the stream */
+	    int stream;
+	    /** timestamp of the sample */
+	    base::Time sample_time;
+	    /** time between the sample and the latest sample of the aligner,
+	     * when it was given to the callback */
+	    base::Time lag;
+	    /** time the sample spent in the stream buffer, null if the
+	     * stream has no residence budget */
+	    base::Time residence;
+	    /** count of violations on this stream since the previous alarm,
+	     * including this one */
+	    size_t violations;
+	};
+	typedef boost::function<void (const LatencyViolation &violation)> latency_alarm_t;
+
+    protected:
+	latency_alarm_t latency_alarm;
+	/** minimum data time between two alarms of the same stream */
+	base::Time alarm_interval;
+
+	/** temporary object that gets returned by getStatus, 
+	 * in order to avoid dynamic allocation on each call
+	 */  
+	mutable StreamAlignerStatus status;
+
+	/** @return the stream with the given index, checked for validity and
+	 * for the sample type
+	 */
+	template <class T> Stream<T>* getStream( int idx ) const
+	{
+	    Stream<T>* stream = dynamic_cast<Stream<T>*>(getStreamBase( idx ));
+	    assert( stream );
+	    return stream;
+	}
+
+	/** @return the input interface of a stream with a transform stage
+	 */
+	template <class T> StreamInput<T>* getStreamInput( int idx ) const
+	{
+	    StreamInput<T>* input = dynamic_cast<StreamInput<T>*>(getStreamBase( idx ));
+	    assert( input );
+	    return input;
+	}
+
+	StreamBase* getStreamBase( int idx ) const
+	{
+	    if( !streams.at(idx) )
+		throw std::runtime_error("invalid stream index.");
+	    return streams[idx];
+	}
+
+	Cursor &getCursor( int cursor )
+	{
+	    if( cursor < 0 || cursor >= static_cast<int>(cursors.size()) )
+		throw std::runtime_error("invalid cursor index.");
+	    return cursors[cursor];
+	}
+
+	const Cursor &getCursor( int cursor ) const
+	{
+	    return const_cast<StreamAligner*>(this)->getCursor( cursor );
+	}
+
+	/** allocates the memory for a stream of type S from the given resource.
+	 * The stream must then be constructed in it and handed to
+	 * setStreamMemory(), or the memory released with deallocateStream().
+	 */
+	template <class S> static void* allocateStream( MemoryResource *resource )
+	{
+	    return resource->allocate( sizeof(S), boost::alignment_of<S>::value );
+	}
+
+	template <class S> static void deallocateStream( void *ptr, MemoryResource *resource )
+	{
+	    resource->deallocate( ptr, sizeof(S), boost::alignment_of<S>::value );
+	}
+
+	template <class S> static S* setStreamMemory( S *stream, MemoryResource *resource )
+	{
+	    stream->memory_resource = resource;
+	    stream->memory_size = sizeof(S);
+	    stream->memory_alignment = boost::alignment_of<S>::value;
+	    return stream;
+	}
+
+	/** destroys a stream and releases its memory */
+	static void deleteStream( StreamBase *stream )
+	{
+	    MemoryResource *resource = stream->memory_resource;
+	    if( !resource )
+	    {
+		delete stream;
+		return;
+	    }
+
+	    size_t size = stream->memory_size;
+	    size_t alignment = stream->memory_alignment;
+	    stream->~StreamBase();
+	    resource->deallocate( stream, size, alignment );
+	}
+
+	/** hands the current timeout and buffer size factor to the streams */
+	void updateBufferSizing()
+	{
+	    for(size_t i=0;i<streams.size();i++)
+	    {
+		if(streams[i])
+		    streams[i]->setBufferSizing( getMaxTimeout(), buffer_size_factor, !realtime );
+	    }
+	}
+
+	/** throws if the configuration is locked by the real-time mode */
+	void checkConfigurable() const
+	{
+	    if( realtime )
+		throw std::runtime_error("the stream aligner configuration cannot be changed in real-time mode.");
+	}
+
+	/** adds a newly created stream to the aligner, reusing the slot of a
+	 * previously unregistered stream if there is one
+	 *
+	 * @result - stream index
+	 */
+	int addStream( StreamBase *newStream )
+	{
+	    newStream->setCursorCount( cursors.size() );
+	    newStream->setBufferSizing( getMaxTimeout(), buffer_size_factor, !realtime );
+
+	    // the new stream is active, and may make the aligner wait
+	    int idx = insertStream( newStream );
+	    updateReadiness();
+	    return idx;
+	}
+
+	int insertStream( StreamBase *newStream )
+	{
+	    //check if there is a free slot from a previous deleted stream
+	    for(size_t i = 0; i < streams.size(); i++)
+	    {
+		if(!streams[i])
+		{
+		    streams[i] = newStream;
+		    status.streams[i] = newStream->getBufferStatus();
+		    return i;
+		}
+	    }
+		
+	    streams.push_back( newStream );
+	    sorted_streams.resize( streams.size() );
+	    status.streams.push_back( newStream->getBufferStatus() );
+	    return streams.size() - 1;
+	}
+
+	/** the largest timeout of all read cursors, used to size the buffers */
+	base::Time getMaxTimeout() const
+	{
+	    base::Time result;
+	    for(size_t i=0;i<cursors.size();i++)
+		result = std::max( result, cursors[i].timeout );
+	    return result;
+	}
+
+    public:
+	explicit StreamAligner(base::Time timeout = base::Time::fromSeconds(1))
+	    : cursors(1, Cursor(timeout)), buffer_size_factor(2.0), realtime(false),
+	      memory_resource(getDefaultMemoryResource()), notifier(0), notifier_cursor(0),
+	      alarm_interval(base::Time::fromSeconds(1)) {}
+
+	virtual ~StreamAligner()
+	{
+	    delete notifier;
+	    for(stream_vector::iterator it=streams.begin();it != streams.end();it++)
+	    {
+		if(*it)
+		    deleteStream( *it );
+	    }
+	}
+
+	/** will take the state of other StreamAligner and make it the state of this 
+	 * object. State constitutes current_time and latest_time as well as all the stream
+	 * content, but not the configuration.
+	 */
+	void copyState(const StreamAligner& other)
+	{
+	    latest_ts = other.latest_ts;
+	    first_ts = other.first_ts;
+
+	    if( cursors.size() != other.cursors.size() )
+		throw std::runtime_error("Cursor setup of second stream aligner differs");
+	    for(size_t i=0;i<cursors.size();i++)
+		cursors[i].current_ts = other.cursors[i].current_ts;
+
+	    assert( streams.size() == other.streams.size() );
+	    for(size_t i=0;i<streams.size();i++)
+	    {
+		bool weGotStream = streams[i];
+		bool otherGotStream = other.streams[i];
+		if(weGotStream != otherGotStream)
+		    throw std::runtime_error("Stream setup of second stream aligner differs");
+		    
+		if(streams[i])
+		{
+		    streams[i]->copyState( *other.streams[i] );
+		    streams[i]->copyStatistics( *other.streams[i] );
+		}
+	    }
+	    updateReadiness();
+	}
+
+	/** Set the time the Estimator will wait for an expected reading on any of the streams.
+	 * This number effectively puts an upper limit to the lag that can be created due to 
+	 * delay or missing values on the channels.
+	 */
+	void setTimeout(const base::Time &t )
+	{
+	    cursors[0].timeout = t;
+	    updateBufferSizing();
+	    updateReadiness();
+	}
+
+	/** Set the timeout of the given read cursor. See addCursor().
+	 */
+	void setTimeout( int cursor, const base::Time &t )
+	{
+	    getCursor( cursor ).timeout = t;
+	    updateBufferSizing();
+	    updateReadiness();
+	}
+
+	/** Sets the safety factor applied to the buffer sizes that are
+	 * computed from the timeout and the sample period. The default is 2.
+	 *
+	 * The buffers of the streams registered without an explicit buffer
+	 * size follow the measured sample period and the current timeout: they
+	 * grow as soon as they are too small for
+	 *
+	 *   factor * ceil( timeout / period )
+	 *
+	 * samples, and shrink once they are more than twice as large as that.
+	 * Resizing keeps the buffered samples. It does not happen in real-time
+	 * mode.
+	 */
+	void setBufferSizeFactor( double factor )
+	{
+	    if( factor <= 0 )
+		throw std::runtime_error("the buffer size factor must be positive.");
+	    buffer_size_factor = factor;
+	    updateBufferSizing();
+	}
+
+	/** @return the safety factor applied to computed buffer sizes */
+	double getBufferSizeFactor() const { return buffer_size_factor; }
+
+	/** Adds a read cursor to the aligner.
+	 *
+	 * A read cursor replays the samples of all streams independently of
+	 * the other cursors, with its own timeout and its own callbacks (see
+	 * setCursorCallback()). It is advanced with step(int). The stream
+	 * buffers are shared between all cursors, and a sample is released
+	 * once every cursor consumed it. The buffers therefore need to be large
+	 * enough for the largest timeout.
+	 *
+	 * A sample that arrives too late for a cursor is skipped by that
+	 * cursor only. It is dropped if it is too late for all cursors.
+	 *
+	 * Cursor 0 always exists. It is the one used by step(), setTimeout()
+	 * and the callbacks given to registerStream().
+	 *
+	 * @result - cursor index
+	 */
+	int addCursor( const base::Time &timeout )
+	{
+	    checkConfigurable();
+	    cursors.push_back( Cursor( timeout ) );
+	    for(size_t i=0;i<streams.size();i++)
+	    {
+		if(streams[i])
+		    streams[i]->setCursorCount( cursors.size() );
+	    }
+	    updateBufferSizing();
+	    return cursors.size() - 1;
+	}
+
+	/** @return the number of read cursors */
+	int getCursorCount() const { return cursors.size(); }
+
+	/** Sets the callback that is called when the given read cursor
+	 * replays samples of the given stream.
+	 */
+	template <class T> void setCursorCallback( int cursor, int idx, typename Stream<T>::callback_t callback )
+	{
+	    getCursor( cursor );
+	    CompressedStream<T>* compressed = dynamic_cast<CompressedStream<T>*>(getStreamBase( idx ));
+	    if( compressed )
+		compressed->setCallback( callback, cursor );
+	    else
+		getStream<T>( idx )->setCallback( callback, cursor );
+	}
+
+	/** Sets a callback for the given read cursor and stream which may take
+	 * the samples over, see registerMoveStream()
+	 */
+	template <class T> void setCursorMoveCallback( int cursor, int idx, typename Stream<T>::move_callback_t callback )
+	{
+	    getCursor( cursor );
+	    getStream<T>( idx )->setMoveCallback( callback, cursor );
+	}
+
+	/** Sets the callback of a tick stream for the given read cursor */
+	void setCursorTickCallback( int cursor, int idx, TickStream::callback_t callback )
+	{
+	    getCursor( cursor );
+	    getTickStream( idx )->setCallback( callback, cursor );
+	}
+
+	/** @overload for packet streams */
+	void setCursorCallback( int cursor, int idx, PacketStream::callback_t callback )
+	{
+	    getCursor( cursor );
+	    getPacketStream( idx )->setCallback( callback, cursor );
+	}
+
+	/** 
+	 * Will disable the stream with the given index.  
+	 *
+	 * All data left in the stream will still be played out, however the
+	 * stream will be ignored for lookahead and timeout calculation. A
+	 * stream, which is disabled can be enabled through the enableStream()
+	 * call, or if new data in this stream arrives.
+	 *
+	 * The functionality is needed for cases where streams might be
+	 * optional, so that the other streams won't be delayed up to the
+	 * maximum time out value.
+	 */
+	void disableStream( int idx )
+	{
+	    if(!streams[idx])
+		throw std::runtime_error("invalid stream index.");		
+
+	    streams[idx]->setActive( false );
+	    updateReadiness();
+	}
+
+	/** 
+	 * Enables a stream which has been disabled previously. 
+	 *
+	 * All streams are enabled by default. Does not have any effect on
+	 * streams which are already enabled.
+	 */
+	void enableStream( int idx )
+	{
+	    if(!streams[idx])
+		throw std::runtime_error("invalid stream index.");		
+
+	    streams[idx]->setActive( true );
+	    updateReadiness();
+	}
+
+	/** 
+	 * See if a stream is enabled or disabled.
+	 *
+	 * @return true if the stream is enabled (active)
+	 */
+	bool isStreamActive( int idx ) const 
+	{
+	    if(!streams[idx])
+		throw std::runtime_error("invalid stream index.");		
+
+	    return streams[idx]->isActive();
+	}
+
+	/**
+	 * Enables or disables the real-time mode.
+	 *
+	 * In real-time mode, the memory of the aligner is fixed: push(),
+	 * step(), getBufferStatus() and getStatus() do not allocate, provided
+	 * that copying the samples and calling the callbacks does not allocate
+	 * either. Streams, cursors and the real-time mode should therefore be
+	 * set up at configuration time.
+	 *
+	 * While the mode is enabled, registering or unregistering streams,
+	 * adding cursors and setting duplicate filters throws. The mode
+	 * cannot be enabled while a stream has a dynamically sized buffer
+	 * (i.e. a buffer size of 0).
+	 */
+	void setRealtimeMode( bool enable )
+	{
+	    if( enable )
+	    {
+		for(size_t i=0;i<streams.size();i++)
+		{
+		    if( streams[i] && streams[i]->isDynamicallySized() )
+			throw std::runtime_error("real-time mode requires fixed buffer sizes for all streams.");
+		}
+	    }
+	    realtime = enable;
+	    updateBufferSizing();
+	}
+
+	/** @return true if the real-time mode is enabled */
+	bool isRealtimeMode() const { return realtime; }
+
+	/**
+	 * This function will remove the stream with the given index from the
+	 * stream aligner.
+	 * 
+	 * @param idx index of the stream that should be unregistered 
+	 */
+	void unregisterStream(int idx)
+	{
+	    checkConfigurable();
+	    if(!streams[idx])
+	    {
+		throw std::runtime_error("invalid stream index.");		
+	    }
+	    
+	    deleteStream( streams[idx] );
+	    
+	    streams[idx] = 0;
+	    
+	    status.streams[idx].active = false;
+	    updateReadiness();
+	}
+
+	/** Will register a stream with the aggregator.
+	 *
+	 * @param callback - will be called for data gone through the synchronization process
+	 * @param period - time between sensor readings. This will be used to estimate when the 
+	 *	next reading should arrive, so out of order arrivals are
+	 *	possible. Set to 0 if not a periodic stream. When set to a
+	 *	negative value, the calculation of the buffer is performed for
+	 *	that period, however no lookahead is set.
+	 * @param bufferSize - The size of the internal FIFO buffer. This should be at least 
+	 *  	the amount of samples that can occur in a timeout period. If no
+	 *  	value is provided, the bufferSize is calculated from the period
+	 *  	and timeout values provided, with an additional safety factor.
+	 *  	The buffer is then resized at runtime from the measured sample
+	 *  	period and the current timeout (see setBufferSizeFactor()).
+	 * @param priority - if streams have data with equal timestamps, the
+	 *      one with the lower priority value will be pushed first.
+	 *
+	 * @param name - name of the stream. This is only for debug purposes
+	 *
+	 * @param resource - memory resource from which the stream and its
+	 *      buffer are allocated. If null, the resource set with
+	 *      setMemoryResource() is used.
+	 * 
+	 * @result - stream index, which is used to identify the stream (e.g. for push).
+	 */
+	template <class T> int registerStream( typename Stream<T>::callback_t callback, int bufferSize, base::Time period, int priority  = -1, const std::string &name = std::string(), MemoryResource *resource = 0) 
+	{
+	    checkConfigurable();
+	    base::Time sizingPeriod = computeBufferSize( bufferSize, period, name );
+
+	    if( !resource )
+		resource = memory_resource;
+
+	    void *ptr = allocateStream< Stream<T> >( resource );
+	    Stream<T> *newStream;
+	    try
+	    {
+		newStream = new (ptr) Stream<T>(callback, bufferSize, period, priority, name, resource);
+	    }
+	    catch(...)
+	    {
+		deallocateStream< Stream<T> >( ptr, resource );
+		throw;
+	    }
+
+	    if( !sizingPeriod.isNull() )
+		newStream->setAutoSize( sizingPeriod );
+	    return addStream( setStreamMemory( newStream, resource ) );
+	}
+
+	/** Will register a stream with a transform stage.
+	 *
+	 * Samples of type T pushed into the stream are given to the transform
+	 * stage within push(), i.e. in the thread of the producer. The stage
+	 * either writes a sample of type U, which is buffered and given to the
+	 * callback, or rejects the sample, which is then counted as filtered in
+	 * the stream status. The stage can keep state, e.g. to downsample.
+	 *
+	 * The stream is a Stream<U>, i.e. cursor callbacks and getNextSample()
+	 * use the type U, while push() uses the type T.
+	 *
+	 * See registerStream() for the other parameters.
+	 */
+	template <class T, class U> int registerTransformStream( typename TransformStream<T,U>::transform_t transform, typename Stream<U>::callback_t callback, int bufferSize, base::Time period, int priority  = -1, const std::string &name = std::string(), MemoryResource *resource = 0) 
+	{
+	    checkConfigurable();
+	    base::Time sizingPeriod = computeBufferSize( bufferSize, period, name );
+
+	    if( !resource )
+		resource = memory_resource;
+
+	    void *ptr = allocateStream< TransformStream<T,U> >( resource );
+	    TransformStream<T,U> *newStream;
+	    try
+	    {
+		newStream = new (ptr) TransformStream<T,U>(transform, callback, bufferSize, period, priority, name, resource);
+	    }
+	    catch(...)
+	    {
+		deallocateStream< TransformStream<T,U> >( ptr, resource );
+		throw;
+	    }
+
+	    if( !sizingPeriod.isNull() )
+		newStream->setAutoSize( sizingPeriod );
+	    return addStream( setStreamMemory( newStream, resource ) );
+	}
+
+	/** Will register a stream which reduces its samples per time bucket.
+	 *
+	 * Samples of type T pushed into the stream are folded into an
+	 * accumulator of type A within push(), and are not buffered. Each
+	 * bucket of the given width gets its own accumulator, starting from
+	 * \c initial. Once a sample of a later bucket comes in, the
+	 * accumulator is buffered with the time of the end of its bucket and
+	 * given to the callback in order with the other streams. Buckets
+	 * without samples are skipped. Use flushStream() to close the last
+	 * bucket, e.g. at the end of a log.
+	 *
+	 * The buffer only holds closed buckets, so it can be small. ReductionSummary
+	 * provides a fold computing the minimum, maximum, mean and last value.
+	 *
+	 * @param width - width of the buckets, which is also the period of the
+	 *      stream. Must be positive
+	 *
+	 * See registerStream() for the other parameters.
+	 */
+	template <class T, class A> int registerReductionStream( typename ReductionStream<T,A>::fold_t fold, const A &initial, base::Time width, typename Stream<A>::callback_t callback, int bufferSize, int priority  = -1, const std::string &name = std::string(), MemoryResource *resource = 0) 
+	{
+	    checkConfigurable();
+	    if( width <= base::Time() )
+		throw std::runtime_error("The bucket width of a reduction stream must be positive.");
+	    base::Time sizingPeriod = computeBufferSize( bufferSize, width, name );
+
+	    if( !resource )
+		resource = memory_resource;
+
+	    void *ptr = allocateStream< ReductionStream<T,A> >( resource );
+	    ReductionStream<T,A> *newStream;
+	    try
+	    {
+		newStream = new (ptr) ReductionStream<T,A>(fold, initial, width, callback, bufferSize, priority, name, resource);
+	    }
+	    catch(...)
+	    {
+		deallocateStream< ReductionStream<T,A> >( ptr, resource );
+		throw;
+	    }
+
+	    if( !sizingPeriod.isNull() )
+		newStream->setAutoSize( sizingPeriod );
+	    return addStream( setStreamMemory( newStream, resource ) );
+	}
+
+	/** Closes the bucket a reduction stream is accumulating, so that it
+	 * gets buffered and given to the callback. Does nothing for the other
+	 * streams. See registerReductionStream().
+	 */
+	void flushStream( int idx )
+	{
+	    StreamBase* stream = getStreamBase( idx );
+	    if( stream->flushInput() )
+		addedSample( stream, stream->latestDataTime() );
+	    updateReadiness();
+	}
+
+	/** Will register a stream whose callback may take the samples over.
+	 *
+	 * The callback gets a mutable reference on the buffered sample, which
+	 * is destroyed right after the call. It can therefore swap or move the
+	 * sample out of the stream instead of copying it. When read cursors are
+	 * used, only the last cursor reading a sample gets the buffered sample,
+	 * the other ones get a copy.
+	 *
+	 * See registerStream() for the parameters.
+	 */
+	template <class T> int registerMoveStream( typename Stream<T>::move_callback_t callback, int bufferSize, base::Time period, int priority  = -1, const std::string &name = std::string(), MemoryResource *resource = 0) 
+	{
+	    int idx = registerStream<T>( typename Stream<T>::callback_t(), bufferSize, period, priority, name, resource );
+	    getStream<T>( idx )->setMoveCallback( callback );
+	    return idx;
+	}
+
+	/** Sets the memory resource from which the streams registered
+	 * afterwards, and their buffers, are allocated, unless registerStream()
+	 * is given a resource explicitly. Does not affect the existing
+	 * streams.
+	 *
+	 * The resource must outlive the streams allocated from it. If null,
+	 * the default resource (operator new) is used.
+	 */
+	void setMemoryResource( MemoryResource *resource )
+	{
+	    memory_resource = resource ? resource : getDefaultMemoryResource();
+	}
+
+	/** @return the memory resource used for new streams */
+	MemoryResource* getMemoryResource() const { return memory_resource; }
+
+	/** Enables the recording of the arrival lateness of the samples.
+	 *
+	 * When a sample is pushed, the difference between the current time
+	 * and the sample's timestamp is added to a histogram of its stream.
+	 * The percentiles of that histogram are reported in the stream status,
+	 * and show which timeout is needed to not drop late samples.
+	 *
+	 * @param clock - gives the current time. It should be monotonic, and
+	 *      is called once per sample
+	 * @param offset - added to the time given by the clock to convert it
+	 *      to the time base of the sample timestamps, e.g. the offset
+	 *      between the system clock and a monotonic clock
+	 */
+	void enableLatenessTracking( arrival_clock_t clock = &base::Time::now, const base::Time &offset = base::Time() )
+	{
+	    arrival_clock = clock;
+	    arrival_offset = offset;
+	}
+
+	void disableLatenessTracking()
+	{
+	    arrival_clock = arrival_clock_t();
+	}
+
+	/** Sets the latency budget of a stream.
+	 *
+	 * Each sample given to the callback of the stream through the primary
+	 * cursor is checked against the budget. Samples over budget are
+	 * counted in the stream status, and raise an alarm, see
+	 * setLatencyAlarm().
+	 *
+	 * @param lag - largest allowed time between the sample and the
+	 *      latest sample of the aligner when the sample is given to the
+	 *      callback. No limit if null.
+	 * @param residence - largest allowed time the sample spends in the
+	 *      stream buffer, measured with the clock given to
+	 *      enableLatenessTracking() or with the system clock. No limit if
+	 *      null. Measuring it makes the stream record the arrival time
+	 *      of each sample, which is not supported by packet and tick
+	 *      streams.
+	 */
+	void setLatencyBudget( int idx, const base::Time &lag, const base::Time &residence = base::Time() )
+	{
+	    StreamBase* stream = getStreamBase( idx );
+	    bool tracks_arrival = !residence.isNull();
+	    if( tracks_arrival != stream->tracks_arrival )
+	    {
+		checkConfigurable();
+		stream->setArrivalTracking( tracks_arrival, getArrivalTime() );
+	    }
+	    stream->lag_budget = lag;
+	    stream->residence_budget = residence;
+	    stream->has_budget = !lag.isNull() || !residence.isNull();
+	}
+
+	/** Sets the hook called for the samples exceeding the latency budget
+	 * of their stream.
+	 *
+	 * The hook is called from step(). To not flood it, a stream raises
+	 * at most one alarm per interval of data time. The violations in
+	 * between are only counted.
+	 */
+	void setLatencyAlarm( latency_alarm_t alarm, const base::Time &interval = base::Time::fromSeconds(1) )
+	{
+	    latency_alarm = alarm;
+	    alarm_interval = interval;
+	}
+
+	/** Drops the samples of a stream whose timestamp is the same as the
+	 * timestamp of one of the recently pushed samples, e.g. the second
+	 * copy of samples received over two redundant links.
+	 *
+	 * The duplicates are counted in the samples_duplicate field of the
+	 * stream status, and do not reach the buffer or the callbacks. The
+	 * check is done in push() and takes constant time.
+	 *
+	 * @param window - count of recent samples a new sample is compared
+	 *      to. Zero disables the filter
+	 */
+	void setDuplicateFilter( int idx, size_t window )
+	{
+	    checkConfigurable();
+	    StreamBase* stream = getStreamBase( idx );
+	    stream->recent_keys.setCapacity( window );
+	    delete stream->duplicate_key;
+	    stream->duplicate_key = 0;
+	}
+
+	/** @overload drops the samples whose key is the same as the key of
+	 * one of the recently pushed samples
+	 *
+	 * @param key - gives the key of a sample, e.g. its sequence number.
+	 *      T is the type given to push(), i.e. the input type of streams
+	 *      with an input stage and ByteSpan for packet streams
+	 */
+	template <class T> void setDuplicateFilter( int idx, const boost::function<uint64_t (const T&)> &key, size_t window )
+	{
+	    checkConfigurable();
+	    StreamBase* stream = getStreamBase( idx );
+	    DuplicateKey<T> *duplicate_key = new DuplicateKey<T>( key );
+	    stream->recent_keys.setCapacity( window );
+	    delete stream->duplicate_key;
+	    stream->duplicate_key = duplicate_key;
+	}
+
+	/** Will register a stream of variable-length packets with the
+	 * aggregator.
+	 *
+	 * The packets are pushed with pushPacket(), and stored contiguously in
+	 * a byte ring of fixed size, so that buffering them does not allocate
+	 * memory. When the ring is full, the oldest packets are dropped.
+	 *
+	 * @param callback - will be called with a view on the packets gone
+	 *      through the synchronization process. The view is only valid
+	 *      during the call
+	 * @param bufferSize - size of the byte ring, in bytes. Each packet
+	 *      uses 16 bytes for its timestamp and length in addition to its
+	 *      payload, which is padded to 8 bytes
+	 *
+	 * See registerStream() for the other parameters.
+	 */
+	int registerPacketStream( PacketStream::callback_t callback, size_t bufferSize, base::Time period, int priority = -1, const std::string &name = std::string(), MemoryResource *resource = 0 )
+	{
+	    checkConfigurable();
+	    if( !resource )
+		resource = memory_resource;
+
+	    void *ptr = allocateStream<PacketStream>( resource );
+	    PacketStream *newStream;
+	    try
+	    {
+		newStream = new (ptr) PacketStream(callback, bufferSize, period, priority, name, resource);
+	    }
+	    catch(...)
+	    {
+		deallocateStream<PacketStream>( ptr, resource );
+		throw;
+	    }
+	    return addStream( setStreamMemory( newStream, resource ) );
+	}
+	
+	/** Will register a stream of numeric samples which are buffered
+	 * compressed.
+	 *
+	 * Samples are pushed with push(), and coded into blocks of a fixed
+	 * memory size: the timestamps as the change of the sample period, and
+	 * the values as the XOR (floating point) or the difference (integers)
+	 * with the previous value. They are decoded when they are given to the
+	 * callback. Regularly sampled, slowly changing values take a few bits
+	 * per sample instead of the size of the timestamp and the value. When
+	 * all blocks are full, the oldest block is dropped.
+	 *
+	 * T must have a CompressedSampleTraits, which is defined for the
+	 * arithmetic types and boost::array of them. getNextSample() is not
+	 * available for these streams.
+	 *
+	 * @param bufferSize - memory of the compressed samples, in bytes. It
+	 *      must hold at least two blocks, see
+	 *      CompressedSampleBuffer::blockSize()
+	 *
+	 * See registerStream() for the other parameters.
+	 */
+	template <class T> int registerCompressedStream( typename CompressedStream<T>::callback_t callback, size_t bufferSize, base::Time period, int priority = -1, const std::string &name = std::string(), MemoryResource *resource = 0 )
+	{
+	    checkConfigurable();
+	    if( !resource )
+		resource = memory_resource;
+
+	    void *ptr = allocateStream< CompressedStream<T> >( resource );
+	    CompressedStream<T> *newStream;
+	    try
+	    {
+		newStream = new (ptr) CompressedStream<T>(callback, bufferSize, period, priority, name, resource);
+	    }
+	    catch(...)
+	    {
+		deallocateStream< CompressedStream<T> >( ptr, resource );
+		throw;
+	    }
+	    return addStream( setStreamMemory( newStream, resource ) );
+	}
+	
+	/** Will register a stream of periodic ticks.
+	 *
+	 * The callback is called at each multiple of the period, in order with
+	 * the samples of the other streams. Ticks are generated on demand
+	 * and start with the first multiple of the period that is not earlier
+	 * than the first sample received by the aggregator. A tick is given to
+	 * the callback once a sample with the same or a later time came in.
+	 *
+	 * The tick stream has no buffer and does not make the aggregator wait,
+	 * it must therefore not be enabled with enableStream(), and nothing can
+	 * be pushed into it.
+	 *
+	 * @param callback - will be called with the time of each tick
+	 * @param period - time between two ticks, must be positive
+	 *
+	 * See registerStream() for the other parameters.
+	 */
+	int registerTickStream( TickStream::callback_t callback, base::Time period, int priority = -1, const std::string &name = std::string(), MemoryResource *resource = 0 )
+	{
+	    checkConfigurable();
+	    if( period <= base::Time() )
+		throw std::runtime_error("The period of a tick stream must be positive.");
+	    if( !resource )
+		resource = memory_resource;
+
+	    void *ptr = allocateStream<TickStream>( resource );
+	    TickStream *newStream;
+	    try
+	    {
+		newStream = new (ptr) TickStream(callback, period, priority, name, &first_ts, &latest_ts);
+	    }
+	    catch(...)
+	    {
+		deallocateStream<TickStream>( ptr, resource );
+		throw;
+	    }
+	    return addStream( setStreamMemory( newStream, resource ) );
+	}
+	
+	/** @brief Push new data into the stream
+	 *
+	 * Note that if the stream was previously inactive, this call will make
+	 * it active implicetely.
+	 *
+	 * @param ts - the timestamp of the data item
+	 * @param data - the data added to the stream
+	 */
+	template <class T> void push( int idx, const base::Time &ts, const T& data )
+	{
+	    StreamBase* input = getStreamBase( idx );
+	    if( isDuplicate( input, ts, data ) )
+		return;
+	    if( input->hasInputStage() )
+	    {
+		// the input stage may buffer a sample with another time, e.g.
+		// the end of a reduction bucket
+		if( acceptSample( input, ts ) && getStreamInput<T>( idx )->pushInput( ts, data ) )
+		    addedSample( input, input->latestDataTime() );
+		updateReadiness();
+		return;
+	    }
+
+	    Stream<T>* stream = getStream<T>( idx );
+
+	    if( acceptSample( stream, ts ) && stream->push( ts, data ) )
+		addedSample( stream, ts );
+	    updateReadiness();
+	}
+
+	/** @brief Push new data into the stream, using the timestamp of the
+	 * data item
+	 *
+	 * The timestamp is looked up with determineTimestamp(), which also
+	 * handles pointers to samples. Streams of shared or intrusive
+	 * pointers buffer the pointers only, not copies of the samples.
+	 */
+	template <class T> void push( int idx, const T& data )
+	{
+	    push( idx, determineTimestamp( data ), data );
+	}
+
+#if __cplusplus >= 201103L
+	/** @brief Push a uniquely owned sample into the stream
+	 *
+	 * The pointer is moved into the stream, which needs to be registered
+	 * for std::unique_ptr<T,D>. Streams of move-only samples can not be
+	 * used with copyState(), and give their samples to only one read
+	 * cursor.
+	 */
+	template <class T, class D> void push( int idx, const base::Time &ts, std::unique_ptr<T,D> data )
+	{
+	    Stream<std::unique_ptr<T,D> >* stream = getStream<std::unique_ptr<T,D> >( idx );
+	    if( isDuplicate( stream, ts, data ) )
+		return;
+
+	    if( acceptSample( stream, ts ) && stream->push( ts, std::move( data ) ) )
+		addedSample( stream, ts );
+	    updateReadiness();
+	}
+
+	/** @overload */
+	template <class T, class D> void push( int idx, std::unique_ptr<T,D> data )
+	{
+	    base::Time ts( determineTimestamp( data ) );
+	    push( idx, ts, std::move( data ) );
+	}
+#endif
+
+	/** @brief Push a new packet into a packet stream
+	 *
+	 * The packet is copied into the stream's ring buffer. See
+	 * registerPacketStream().
+	 */
+	void pushPacket( int idx, const base::Time &ts, const uint8_t *data, size_t size )
+	{
+	    PacketStream* stream = getPacketStream( idx );
+	    if( isDuplicate( stream, ts, ByteSpan( data, size ) ) )
+		return;
 
-    public:
-	explicit StreamAligner(base::Time timeout = base::Time::fromSeconds(1))
-	    : timeout(timeout), buffer_size_factor(2.0) {}
+	    if( acceptSample( stream, ts ) && stream->push( ts, data, size ) )
+		addedSample( stream, ts );
+	    updateReadiness();
+	}
 
-	virtual ~StreamAligner()
+	/** @overload */
+	void pushPacket( int idx, const base::Time &ts, const std::vector<uint8_t> &data )
 	{
-	    for(stream_vector::iterator it=streams.begin();it != streams.end();it++)
-		delete *it;
+	    pushPacket( idx, ts, data.empty() ? 0 : &data[0], data.size() );
 	}
 
-	/** will take the state of other StreamAligner and make it the state of this 
-	 * object. State constitutes current_time and latest_time as well as all the stream
-	 * content, but not the configuration.
-	 */
-	void copyState(const StreamAligner& other)
+	/** @overload */
+	void pushPacket( int idx, const base::Time &ts, const std::string &data )
 	{
-	    latest_ts = other.latest_ts;
-	    current_ts = other.current_ts;
-
-	    assert( streams.size() == other.streams.size() );
-	    for(size_t i=0;i<streams.size();i++)
-	    {
-		bool weGotStream = streams[i];
-		bool otherGotStream = other.streams[i];
-		if(weGotStream != otherGotStream)
-		    throw std::runtime_error("Stream setup of second stream aligner differs");
-		    
-		if(streams[i])
-		{
-		    streams[i]->copyState( *other.streams[i] );
-		}
-	    }
+	    pushPacket( idx, ts, reinterpret_cast<const uint8_t*>( data.data() ), data.size() );
 	}
 
-	/** Set the time the Estimator will wait for an expected reading on any of the streams.
-	 * This number effectively puts an upper limit to the lag that can be created due to 
-	 * delay or missing values on the channels.
+    protected:
+	/** counts a newly received sample in the statistics of its stream,
+	 * whether it is kept or dropped afterwards
 	 */
-	void setTimeout(const base::Time &t )
+	void countReceived( StreamBase *stream, const base::Time &ts )
 	{
-	    timeout = t;
+	    AGGREGATOR_STATUS_UPDATE( stream->status.samples_received++; )
+	    AGGREGATOR_STATUS_UPDATE( stream->status.latest_sample_time = ts; )
 	}
 
-	/** 
-	 * Will disable the stream with the given index.  
-	 *
-	 * All data left in the stream will still be played out, however the
-	 * stream will be ignored for lookahead and timeout calculation. A
-	 * stream, which is disabled can be enabled through the enableStream()
-	 * call, or if new data in this stream arrives.
+	/** checks a new sample against the duplicate filter of its stream,
+	 * see setDuplicateFilter()
 	 *
-	 * The functionality is needed for cases where streams might be
-	 * optional, so that the other streams won't be delayed up to the
-	 * maximum time out value.
+	 * @result - true if the sample is a duplicate, which has been counted
+	 *      and must be dropped
 	 */
-	void disableStream( int idx )
+	template <class T> bool isDuplicate( StreamBase *stream, const base::Time &ts, const T &data )
 	{
-	    if(!streams[idx])
-		throw std::runtime_error("invalid stream index.");		
+	    if( !stream->recent_keys.capacity() )
+		return false;
 
-	    streams[idx]->setActive( false );
+	    uint64_t key = ts.toMicroseconds();
+	    if( stream->duplicate_key )
+	    {
+		DuplicateKey<T> *duplicate_key = dynamic_cast<DuplicateKey<T>*>( stream->duplicate_key );
+		if( !duplicate_key )
+		    throw std::runtime_error("the duplicate key of stream " + stream->status.name + " does not take the pushed sample type.");
+		key = duplicate_key->key( data );
+	    }
+
+	    if( stream->recent_keys.insert( key ) )
+		return false;
+
+	    countReceived( stream, ts );
+	    AGGREGATOR_STATUS_UPDATE( stream->status.samples_duplicate++; )
+	    return true;
 	}
 
-	/** 
-	 * Enables a stream which has been disabled previously. 
+	/** updates the statistics of a stream for a newly received sample,
+	 * and checks whether the sample is late for all cursors
 	 *
-	 * All streams are enabled by default. Does not have any effect on
-	 * streams which are already enabled.
+	 * @return false if the sample should be dropped
 	 */
-	void enableStream( int idx )
+	bool acceptSample( StreamBase *stream, const base::Time &ts )
 	{
-	    if(!streams[idx])
-		throw std::runtime_error("invalid stream index.");		
+	    countReceived( stream, ts );
+	    AGGREGATOR_STATUS_UPDATE( stream->input_rate.update( ts ); )
+	    AGGREGATOR_STATUS_UPDATE( if( arrival_clock ) stream->lateness.add( arrival_clock() + arrival_offset - ts ); )
 
-	    streams[idx]->setActive( true );
+	    // mark stream as active, since it is receiving data items will
+	    // have no effect on an already active stream, but enables
+	    // streams which have been marked passive before.
+	    stream->setActive( true );
+
+	    //any sample, that is older than the last replayed sample
+	    //will never be played back and gets dropped by default
+	    bool late = true;
+	    for(size_t i=0;i<cursors.size();i++)
+	    {
+		if(ts < cursors[i].current_ts) 
+		    cursors[i].samples_dropped_late_arriving++;
+		else
+		    late = false;
+	    }
+	    if(late)
+	    {
+		AGGREGATOR_STATUS_UPDATE( status.samples_dropped_late_arriving++; )
+		AGGREGATOR_STATUS_UPDATE( stream->status.samples_dropped_late_arriving++; )
+		AGGREGATOR_STATUS_UPDATE( stream->drop_rate.update( ts ); )
+		return false;
+	    }
+
+	    if( ts > latest_ts )
+	    {
+		if( latest_ts.isNull() )
+		    first_ts = ts;
+		latest_ts = ts;
+	    }
+	    return true;
 	}
 
-	/** 
-	 * See if a stream is enabled or disabled.
-	 *
-	 * @return true if the stream is enabled (active)
+	/** @return the current time of the clock used to record the arrival of
+	 * the samples, see enableLatenessTracking()
 	 */
-	bool isStreamActive( int idx ) const 
+	base::Time getArrivalTime() const
 	{
-	    if(!streams[idx])
-		throw std::runtime_error("invalid stream index.");		
+	    if( arrival_clock )
+		return arrival_clock() + arrival_offset;
+	    return base::Time::now();
+	}
 
-	    return streams[idx]->isActive();
+	/** checks the sample that was just given out by a stream against the
+	 * latency budget of the stream
+	 */
+	void checkLatencyBudget( StreamBase *stream, const base::Time &ts )
+	{
+	    base::Time lag = latest_ts - ts;
+	    base::Time residence;
+	    if( stream->tracks_arrival )
+		residence = getArrivalTime() - stream->popped_arrival;
+
+	    if( !(!stream->lag_budget.isNull() && lag > stream->lag_budget)
+		&& !(!stream->residence_budget.isNull() && residence > stream->residence_budget) )
+		return;
+
+	    AGGREGATOR_STATUS_UPDATE( stream->status.samples_over_budget++; )
+	    stream->violations++;
+	    if( !latency_alarm )
+		return;
+	    if( !stream->last_alarm.isNull() && ts - stream->last_alarm < alarm_interval )
+		return;
+
+	    LatencyViolation violation;
+	    violation.stream = std::find( streams.begin(), streams.end(), stream ) - streams.begin();
+	    violation.sample_time = ts;
+	    violation.lag = lag;
+	    violation.residence = residence;
+	    violation.violations = stream->violations;
+	    stream->last_alarm = ts;
+	    stream->violations = 0;
+	    latency_alarm( violation );
 	}
 
-	/**
-	 * This function will remove the stream with the given index from the
-	 * stream aligner.
-	 * 
-	 * @param idx index of the stream that should be unregistered 
+	/** called after a sample got added to a stream, to record its arrival
+	 * time if needed and to skip it on the cursors for which it is late
 	 */
-	void unregisterStream(int idx)
+	void addedSample( StreamBase *stream, const base::Time &ts )
 	{
-	    if(!streams[idx])
+	    if( stream->tracks_arrival )
+		stream->recordArrival( getArrivalTime() );
+
+	    // late samples are already rejected by acceptSample(), unless an
+	    // input stage changed the time
+	    if( cursors.size() == 1 && !stream->hasInputStage() )
+		return;
+
+	    for(size_t i=0;i<cursors.size();i++)
 	    {
-		throw std::runtime_error("invalid stream index.");		
+		if(ts < cursors[i].current_ts)
+		    stream->skip( i );
 	    }
-	    
-	    delete streams[idx];
-	    
-	    streams[idx] = 0;
-	    
-	    status.streams[idx].active = false;
 	}
 
-	/** Will register a stream with the aggregator.
-	 *
-	 * @param callback - will be called for data gone through the synchronization process
-	 * @param period - time between sensor readings. This will be used to estimate when the 
-	 *	next reading should arrive, so out of order arrivals are
-	 *	possible. Set to 0 if not a periodic stream. When set to a
-	 *	negative value, the calculation of the buffer is performed for
-	 *	that period, however no lookahead is set.
-	 * @param bufferSize - The size of the internal FIFO buffer. This should be at least 
-	 *  	the amount of samples that can occur in a timeout period. If no
-	 *  	value is provided, the bufferSize is calculated from the period
-	 *  	and timeout values provided, with an additional safety factor.
-	 * @param priority - if streams have data with equal timestamps, the
-	 *      one with the lower priority value will be pushed first.
+	/** Computes the buffer size of a stream that is registered with a
+	 * negative buffer size, see registerStream()
 	 *
-	 * @param name - name of the stream. This is only for debug purposes
-	 * 
-	 * @result - stream index, which is used to identify the stream (e.g. for push).
+	 * @result - the period from which the buffer is sized automatically,
+	 *      or a null time if the buffer has a fixed size
 	 */
-	template <class T> int registerStream( typename Stream<T>::callback_t callback, int bufferSize, base::Time period, int priority  = -1, const std::string &name = std::string()) 
+	base::Time computeBufferSize( int &bufferSize, base::Time &period, const std::string &name ) const
 	{
+	    base::Time sizingPeriod;
 	    if( bufferSize < 0 )
 	    {
 		if( period == base::Time() )
@@ -374,12 +2526,14 @@ namespace aggregator {
 		else if( period < base::Time() )
 		{
 		    // for a negative period, just calculate the buffer size, but don't set any lookahead.
-		    bufferSize = buffer_size_factor * ceil( timeout.toSeconds() / -period.toSeconds() );
+		    bufferSize = buffer_size_factor * ceil( getMaxTimeout().toSeconds() / -period.toSeconds() );
+		    sizingPeriod = base::Time() - period;
 		    period = base::Time();
 		}
 		else
 		{
-		    bufferSize = buffer_size_factor * ceil( timeout.toSeconds() / period.toSeconds() );
+		    bufferSize = buffer_size_factor * ceil( getMaxTimeout().toSeconds() / period.toSeconds() );
+		    sizingPeriod = period;
 		}
 	    }
 
@@ -388,111 +2542,47 @@ namespace aggregator {
 		LOG_DEBUG_S << "dynamically allocating stream aligner buffer for stream: " << name;
 	    }
 
-	    StreamBase *newStream = new Stream<T>(callback, bufferSize, period, priority, name);
-	    
-	    //check if there is a free slot from a previous deleted stream
-	    for(size_t i = 0; i < streams.size(); i++)
-	    {
-		if(!streams[i])
-		{
-		    streams[i] = newStream;
-		    status.streams[i] = StreamStatus();
-		    return i;
-		}
-	    }
-		
-	    streams.push_back( newStream );
-	    status.streams.push_back(StreamStatus());
-	    return streams.size() - 1;
+	    return sizingPeriod;
 	}
-	
-	/** @brief Push new data into the stream
-	 *
-	 * Note that if the stream was previously inactive, this call will make
-	 * it active implicetely.
-	 *
-	 * @param ts - the timestamp of the data item
-	 * @param data - the data added to the stream
-	 */
-	template <class T> void push( int idx, const base::Time &ts, const T& data )
-	{
-	    if( !streams.at(idx) )
-		throw std::runtime_error("invalid stream index.");
 
-	    Stream<T>* stream = dynamic_cast<Stream<T>*>(streams[idx]);
+	PacketStream* getPacketStream( int idx ) const
+	{
+	    PacketStream* stream = dynamic_cast<PacketStream*>(getStreamBase( idx ));
 	    assert( stream );
-
-	    stream->status.samples_received++;
-	    stream->status.latest_sample_time = ts;
-
-	    // mark stream as active, since it is receiving data items will
-	    // have no effect on an already active stream, but enables
-	    // streams which have been marked passive before.
-	    stream->setActive( true );
-
-	    //any sample, that is older than the last replayed sample
-	    //will never be played back and gets dropped by default
-	    if(ts < current_ts) 
-	    {
-		status.samples_dropped_late_arriving++;
-		stream->status.samples_dropped_late_arriving++;
-		return;
-	    }
-
-	    if( ts > latest_ts )
-		latest_ts = ts;
-	    
-	    stream->push( ts, data );
+	    return stream;
 	}
 
-	template <class T> bool getNextSample( int idx, std::pair<base::Time,T> &sample) const
+	TickStream* getTickStream( int idx ) const
 	{
-	    if( !streams.at(idx) )
-		throw std::runtime_error("invalid stream index.");
-
-	    Stream<T>* stream = dynamic_cast<Stream<T>*>(streams[idx]);
+	    TickStream* stream = dynamic_cast<TickStream*>(getStreamBase( idx ));
 	    assert( stream );
-
-	    return stream->getNextSample(sample);
+	    return stream;
 	}
 
-	/** This will go through the available streams and look for the
-	 * oldest available data. The data can be either existing are predicted
-	 * through the period. 
-	 * 
-	 * There are three different cases that can happen:
-	 *  - The data is already available. In this case that data is forwarded
-	 *    to the callback.
-	 *  - The data is not yet available, and the time difference between oldest
-	 *    data and newest data is below the timeout threshold. In this case
-	 *    no data is called.
-	 *  - The data is not yet available, and the timeout is reached. In this
-	 *    case, the oldest data (which is obviously non-available) is ignored,
-	 *    and only newer data is considered.
+	/** looks for the stream from which step() has to pop the next sample
 	 *
-	 *  @result - true if a callback was called and more data might be available 
+	 * @result - the stream, or null if step() has to wait for more data
 	 */
-	bool step()
+	StreamBase* selectStream( int cursor ) const
 	{
+	    const Cursor &c( cursors[cursor] );
+
 	    if( streams.empty() )
-		return false;
+		return 0;
 
 	    // copy streams vector and sort it by next ts
-	    stream_vector items = streams;
-	    std::sort( items.begin(), items.end(), &compareStreams );
+	    stream_vector &items( sorted_streams );
+	    std::copy( streams.begin(), streams.end(), items.begin() );
+	    std::sort( items.begin(), items.end(), CompareStreams( cursor ) );
 
 	    for(stream_vector::iterator it=items.begin();it != items.end();it++)
 	    {
 		//first stream is unregistered no data there
 		if(!*it)
-		    return false;
+		    return 0;
 		
-		if( (*it)->hasData() ) 
-		{
-		    // if stream has current data, pop that data
-		    current_ts = (*it)->pop();
-		    return true;
-		}
+		if( (*it)->hasData(cursor) ) 
+		    return *it;
 		else if( (*it)->isActive() )
 		{
 
@@ -500,35 +2590,133 @@ namespace aggregator {
 		    base::Time firstDataTime;
 		    
 		    //initalization case
-		    if(current_ts == base::Time())
+		    if(c.current_ts == base::Time())
 		    {
 			//check if one stream timed out
 			for(stream_vector::iterator it2=items.begin();it2 != items.end();it2++)
 			{
 			    
-			    if(*it2 && (*it2)->hasData())
+			    if(*it2 && (*it2)->hasData(cursor))
 			    {
 				if(latestDataTime < (*it2)->latestDataTime())
 				    latestDataTime = (*it2)->latestDataTime();
 				
-				if(firstDataTime == base::Time() || firstDataTime > (*it2)->earliestDataTime())
-				    firstDataTime = (*it2)->earliestDataTime();
+				if(firstDataTime == base::Time() || firstDataTime > (*it2)->earliestDataTime(cursor))
+				    firstDataTime = (*it2)->earliestDataTime(cursor);
 			    }
 			}			
 		    } else {
 			latestDataTime = latest_ts;
-			firstDataTime = current_ts;
+			firstDataTime = c.current_ts;
 		    }
 
-		    if(latestDataTime - firstDataTime < timeout)
+		    if(latestDataTime - firstDataTime < c.timeout)
 		    {
 			// if there is no data, but the expected data has
 			// not run out yet, wait for it.
-			return false;
+			return 0;
 		    }
 		}
 	    }
-	    return false;
+	    return 0;
+	}
+
+	/** updates the readiness descriptor after a change of the state of
+	 * the aligner, see enableReadinessNotification() */
+	void updateReadiness()
+	{
+	    if( notifier )
+		notifier->set( selectStream( notifier_cursor ) != 0 );
+	}
+
+    public:
+
+	template <class T> bool getNextSample( int idx, std::pair<base::Time,T> &sample) const
+	{
+	    return getStream<T>( idx )->getNextSample(sample);
+	}
+
+	/** This will go through the available streams and look for the
+	 * oldest available data. The data can be either existing are predicted
+	 * through the period. 
+	 * 
+	 * There are three different cases that can happen:
+	 *  - The data is already available. In this case that data is forwarded
+	 *    to the callback.
+	 *  - The data is not yet available, and the time difference between oldest
+	 *    data and newest data is below the timeout threshold. In this case
+	 *    no data is called.
+	 *  - The data is not yet available, and the timeout is reached. In this
+	 *    case, the oldest data (which is obviously non-available) is ignored,
+	 *    and only newer data is considered.
+	 *
+	 *  @result - true if a callback was called and more data might be available 
+	 */
+	bool step()
+	{
+	    return step( 0 );
+	}
+
+	/** Does a step() for the given read cursor. See addCursor().
+	 */
+	bool step( int cursor )
+	{
+	    Cursor &c( getCursor( cursor ) );
+	    StreamBase *stream = selectStream( cursor );
+	    if( !stream )
+	    {
+		updateReadiness();
+		return false;
+	    }
+
+	    // if stream has current data, pop that data
+	    c.current_ts = stream->pop(cursor);
+	    AGGREGATOR_STATUS_UPDATE( if( cursor == 0 ) stream->processed_rate.update( c.current_ts ); )
+	    if( cursor == 0 && stream->has_budget )
+		checkLatencyBudget( stream, c.current_ts );
+	    updateReadiness();
+	    return true;
+	}
+
+	/** @return true if step() would give a sample to a callback, i.e.
+	 * make progress, for the given read cursor
+	 */
+	bool canStep( int cursor = 0 ) const
+	{
+	    getCursor( cursor );
+	    return selectStream( cursor ) != 0;
+	}
+
+	/** Creates a file descriptor that is readable exactly while step()
+	 * can make progress for the given read cursor, see canStep().
+	 *
+	 * The descriptor can be added to a select(), poll() or epoll() loop,
+	 * which then calls step() until it returns false once it is readable.
+	 * The aligner updates the descriptor itself, it must not be read. As
+	 * the timeouts are in data time, progress only becomes possible
+	 * through calls on the aligner, e.g. push(), so that no timer is
+	 * needed.
+	 *
+	 * Keeping the descriptor up to date costs an evaluation of canStep()
+	 * in each push() and step().
+	 *
+	 * @result - the descriptor, which stays valid until the notification
+	 *      is disabled or the aligner destroyed
+	 */
+	int enableReadinessNotification( int cursor = 0 )
+	{
+	    getCursor( cursor );
+	    if( !notifier )
+		notifier = new ReadinessNotifier;
+	    notifier_cursor = cursor;
+	    updateReadiness();
+	    return notifier->getFileDescriptor();
+	}
+
+	void disableReadinessNotification()
+	{
+	    delete notifier;
+	    notifier = 0;
 	}
 
 	/**
@@ -543,31 +2731,54 @@ namespace aggregator {
 		if(streams[i])
 		{
 		    streams[i]->clear();
+		    streams[i]->recent_keys.clear();
 		}
 	    }
 	    
 	    latest_ts = base::Time();
-	    current_ts = base::Time();
+	    first_ts = base::Time();
+	    for(size_t i=0;i<cursors.size();i++)
+	    {
+		cursors[i].current_ts = base::Time();
+		cursors[i].samples_dropped_late_arriving = 0;
+	    }
 	    
 	    status.current_time = base::Time();
 	    status.latest_time = base::Time();
 	    status.samples_dropped_late_arriving = 0;
+	    updateReadiness();
 	}
 
 	/** Get the time the Estimator will wait for an expected reading on any of the streams.
 	 * This number effectively puts an upper limit to the lag that can be created due to 
 	 * delay or missing values on the channels.
 	 */
-	base::Time getTimeOut() const { return timeout; };
+	base::Time getTimeOut() const { return cursors[0].timeout; };
+
+	/** Get the timeout of the given read cursor */
+	base::Time getTimeOut( int cursor ) const { return getCursor( cursor ).timeout; }
 	
 	/** latency is the time difference between the latest data item that
 	 * has come in, and the latest data item that went out
 	 */
-	base::Time getLatency() const { return latest_ts - current_ts; };
+	base::Time getLatency() const { return latest_ts - cursors[0].current_ts; };
+
+	/** the latency of the given read cursor */
+	base::Time getLatency( int cursor ) const { return latest_ts - getCursor( cursor ).current_ts; }
 
 	/** return the time of the last data item that went out
 	 */
-	base::Time getCurrentTime() const { return current_ts; };
+	base::Time getCurrentTime() const { return cursors[0].current_ts; };
+
+	/** return the time of the last data item that went out through the
+	 * given read cursor
+	 */
+	base::Time getCurrentTime( int cursor ) const { return getCursor( cursor ).current_ts; }
+
+	/** return the count of samples that arrived too late for the given
+	 * read cursor, and have therefore been skipped by it
+	 */
+	size_t getSamplesDroppedLateArriving( int cursor ) const { return getCursor( cursor ).samples_dropped_late_arriving; }
 
 	/** return the time of the last data item that came in
 	 */
@@ -585,6 +2796,7 @@ namespace aggregator {
 	    if( !streams.at(idx) )
 		throw std::runtime_error("invalid stream index.");
 	    
+	    streams[idx]->updateStatistics( latest_ts );
 	    return streams[idx]->getBufferStatus();
 	}
 
@@ -600,7 +2812,10 @@ namespace aggregator {
 	    for(size_t i=0;i<streams.size();i++)
 	    {
 		if(streams[i])
+		{
+		    streams[i]->updateStatistics( latest_ts );
 		    status.streams[i] = streams[i]->getBufferStatus();
+		}
 	    }
 
 	    return status;
@@ -20,7 +20,7 @@ std::ostream &operator<<(std::ostream &os, const aggregator::StreamAlignerStatus
     if( status.streams.empty() )
     	return os; 
     
-    os << "idx\tname\t\tbsize\tbfill\treceived\tprocessed\tdr_bfull\tdr_late\tbackward time" << std::endl;
+    os << "idx\tname\t\tbsize\tbfill\treceived\tprocessed\tdr_bfull\tdr_late\tbackward time\tfiltered\tduplicate\tin Hz\tout Hz\tdrop Hz\tjitter" << std::endl;
 
     int cnt = 0;
     for(std::vector<aggregator::StreamStatus>::const_iterator it = status.streams.begin(); it != status.streams.end(); it++)
@@ -33,7 +33,7 @@ std::ostream &operator<<(std::ostream &os, const aggregator::StreamAlignerStatus
 	cnt++;
     }
     
-    os << "idx\tname\t\tlatest sample\tearliers data\tlatest data\tlatency" << std::endl;
+    os << "idx\tname\t\tlatest sample\tearliers data\tlatest data\tlatency\tlateness p50\tlateness p99" << std::endl;
     
     for(std::vector<aggregator::StreamStatus>::const_iterator it = status.streams.begin(); it != status.streams.end(); it++)
     {
@@ -57,6 +57,12 @@ std::ostream& counters(std::ostream& os, const aggregator::StreamStatus& status)
 	<< status.samples_dropped_buffer_full << "\t"
 	<< status.samples_dropped_late_arriving << "\t"
 	<< status.samples_backward_in_time << "\t"
+	<< status.samples_filtered << "\t"
+	<< status.samples_duplicate << "\t"
+	<< status.input_rate << "\t"
+	<< status.processed_rate << "\t"
+	<< status.drop_rate << "\t"
+	<< status.jitter << "\t"
 	<< std::endl;
     return os;
 }
@@ -68,7 +74,9 @@ std::ostream& timers(std::ostream& os, const aggregator::StreamStatus& status, b
 	<< status.latest_sample_time << "\t"
 	<< status.earliest_data_time << " \t "
 	<< status.latest_data_time << " \t " 
-	<< status.latest_sample_time - current_time 
+	<< status.latest_sample_time - current_time << " \t "
+	<< status.lateness_median << " \t "
+	<< status.lateness_p99
 	<< std::endl;
     return os;
 }
@@ -10,9 +10,16 @@ namespace aggregator
      */
     struct StreamStatus
     {
-	/** The actual size of the buffer */
+	/** The actual size of the buffer
+	 *
+	 * For packet streams, this is the size of the buffer in bytes
+	 */
 	size_t buffer_size;
-	/** How many samples are currently waiting inside the stream buffer */
+	/** How many samples are currently waiting inside the stream buffer
+	 *
+	 * For packet streams, this is the count of bytes used by the waiting
+	 * packets
+	 */
 	size_t buffer_fill;
 	/** The total number of samples ever received for that stream
 	 * 
@@ -20,7 +27,9 @@ namespace aggregator
 	 *   
 	 *   samples_received == samples_processed +
 	 * 	samples_dropped_buffer_full +
-	 * 	samples_dropped_late_arriving
+	 * 	samples_dropped_late_arriving +
+	 * 	samples_filtered +
+	 * 	samples_duplicate
 	 */
 	size_t samples_received;
 	/** The total count of samples ever processed by the callbacks of this stream
@@ -45,6 +54,52 @@ namespace aggregator
 	 * sample received for that stream
 	 */
 	size_t samples_backward_in_time;
+	/** Count of samples rejected by the transform stage of the stream
+	 * 
+	 * Always zero on streams registered without a transform stage
+	 */
+	size_t samples_filtered;
+	/** Count of samples dropped because a sample with the same timestamp
+	 * or key had been received recently
+	 *
+	 * Always zero on streams without duplicate filter, see
+	 * StreamAligner::setDuplicateFilter()
+	 */
+	size_t samples_duplicate;
+	/** Rate at which samples are received, in Hz
+	 *
+	 * The rates are moving averages in data time, evaluated at the time of
+	 * the latest sample received by the stream aligner. They decrease
+	 * once a stream stops receiving samples. Like the counters, they are
+	 * reset by StreamAligner::clear().
+	 */
+	double input_rate;
+	/** Rate at which samples are given to the callback, in Hz */
+	double processed_rate;
+	/** Rate at which samples are dropped because the buffer was full,
+	 * because they arrived late or backward in time, in Hz
+	 */
+	double drop_rate;
+	/** Mean deviation of the time between two received samples, in
+	 * seconds
+	 */
+	double jitter;
+	/** Percentiles of the arrival lateness of the samples, i.e. of the
+	 * time between the timestamp of a sample and its arrival in the stream
+	 * aligner
+	 *
+	 * Null unless lateness tracking has been enabled with
+	 * StreamAligner::enableLatenessTracking()
+	 */
+	base::Time lateness_median;
+	base::Time lateness_p90;
+	base::Time lateness_p99;
+	/** Largest arrival lateness of the samples */
+	base::Time lateness_max;
+	/** Count of samples that exceeded the latency budget of the stream,
+	 * see StreamAligner::setLatencyBudget()
+	 */
+	size_t samples_over_budget;
 	/** Time of the newest sample currently stored in the stream buffer.
 	 * Null time if the stream is empty
 	 */
@@ -72,7 +127,75 @@ namespace aggregator
 	StreamStatus() : buffer_size(0), buffer_fill(0), samples_received(0), 
 			samples_processed(0), samples_dropped_buffer_full(0), 
 			samples_dropped_late_arriving(0), 
-			samples_backward_in_time(0), active(true), priority(0)
+			samples_backward_in_time(0), samples_filtered(0),
+			samples_duplicate(0),
+			input_rate(0), processed_rate(0), drop_rate(0), jitter(0),
+			samples_over_budget(0),
+			active(true), priority(0)
+	{
+	}
+    };
+
+    /** Structure used to report the state of a single subscriber of a
+     * FanOutStreamAligner
+     */
+    struct SubscriberStatus
+    {
+	/** The maximum count of samples this subscriber may lag behind the
+	 * merged output before samples get dropped for it
+	 */
+	size_t max_lag;
+	/** How many merged samples are currently waiting for this subscriber */
+	size_t lag;
+	/** The total count of samples delivered to this subscriber */
+	size_t samples_delivered;
+	/** Count of samples this subscriber lost because it lagged behind by
+	 * more than max_lag
+	 */
+	size_t samples_dropped_lag;
+
+	SubscriberStatus() : max_lag(0), lag(0), samples_delivered(0),
+			samples_dropped_lag(0)
+	{
+	}
+    };
+
+    /** Structure used to report the state of a single source of a
+     * PullStreamAligner
+     */
+    struct PullSourceStatus
+    {
+	/** The name of the source, which is also the name of its stream */
+	std::string name;
+	/** The index of the stream the source pushes into */
+	int index;
+	/** The total count of calls to the pull callback of the source */
+	size_t pulls;
+	/** Count of pulls that returned no sample */
+	size_t empty_pulls;
+	/** Count of samples read from the source, i.e. pulls - empty_pulls */
+	size_t records;
+	/** Percentiles of the time spent in the pull callback.
+	 *
+	 * Null unless pull timing has been enabled with
+	 * PullStreamAligner::enablePullTiming()
+	 */
+	base::Time pull_time_median;
+	base::Time pull_time_p90;
+	base::Time pull_time_p99;
+	/** Longest time spent in the pull callback */
+	base::Time pull_time_max;
+	/** Time of the latest sample read from the source, minus the current
+	 * time of the stream aligner. It is negative if the source lags behind
+	 * the merged output, and null as long as nothing has been read.
+	 */
+	base::Time lead;
+	/** True if a sample has been read and waits to be pushed into the
+	 * stream aligner */
+	bool pending;
+
+	PullSourceStatus() : index(-1), pulls(0), empty_pulls(0), records(0),
+			pending(false)
 	{
 	}
     };
@@ -2,6 +2,7 @@
 #include <limits.h> //for INT_MAX
 #include <iosfwd>
 #include <stdexcept>
+#include <algorithm>
 #include <iostream>
 #include <base/Float.hpp>
 #include <base/Logging.hpp>
@@ -13,6 +14,9 @@ TimestampEstimator::TimestampEstimator(base::Time window,
 				       base::Time initial_period,
 				       base::Time initial_latency,
 				       int lost_threshold)
+    : m_bucket_duration(0)
+    , m_index_bits(64)
+    , m_publish_status(false)
 {
     reset(window, initial_period, initial_latency, lost_threshold);
 }
@@ -20,12 +24,18 @@ TimestampEstimator::TimestampEstimator(base::Time window,
 TimestampEstimator::TimestampEstimator(base::Time window,
 				       base::Time initial_period,
 				       int lost_threshold)
+    : m_bucket_duration(0)
+    , m_index_bits(64)
+    , m_publish_status(false)
 {
     reset(window, initial_period, base::Time(), lost_threshold);
 }
 
 TimestampEstimator::TimestampEstimator(base::Time window,
 				       int lost_threshold)
+    : m_bucket_duration(0)
+    , m_index_bits(64)
+    , m_publish_status(false)
 {
     reset(window, base::Time(), base::Time(), lost_threshold);
 }
@@ -89,19 +99,95 @@ void TimestampEstimator::internalReset(double window,
     m_missing_samples_total = 0;
     m_last_index = 0;
     m_have_last_index = false;
+    m_last_index_time = base::Time();
+    m_index_resets = 0;
     m_expected_losses = 0;
     m_rejected_expected_losses = 0;
     m_expected_loss_timeout = 0;
 
     m_samples.clear();
-    if (m_initial_period > 0)
-        m_samples.set_capacity(10 + (m_window + m_initial_period) / m_initial_period);
+    m_buckets.clear();
+    m_bucket_slots = 0;
+    m_bucket_period = -1;
+    if (m_bucket_duration > 0)
+    {
+        m_samples.set_capacity(0);
+        m_buckets.set_capacity(10 + (m_window + m_bucket_duration) / m_bucket_duration);
+    }
     else
-        m_samples.set_capacity(20); // should be enough to get us a first period estimate
+    {
+        m_buckets.set_capacity(0);
+        if (m_initial_period > 0)
+            m_samples.set_capacity(10 + (m_window + m_initial_period) / m_initial_period);
+        else
+            m_samples.set_capacity(20); // should be enough to get us a first period estimate
+    }
+
+    publishStatus();
+}
+
+void TimestampEstimator::setWindowBucketDuration(base::Time bucket_duration)
+{
+    m_bucket_duration = bucket_duration.toSeconds();
+    reset();
+}
+
+unsigned int TimestampEstimator::getWindowSize() const
+{
+    if (m_bucket_duration > 0)
+        return m_bucket_slots;
+    else
+        return m_samples.size();
 }
 
 base::Time TimestampEstimator::getPeriod() const
 { return base::Time::fromSeconds(getPeriodInternal()); }
+double TimestampEstimator::getBucketPeriod() const
+{
+    if (m_bucket_period >= 0)
+        return m_bucket_period;
+
+    // The least-latency samples are a lot less noisy than the samples at
+    // the window boundaries. The fit goes through all of them, as the
+    // least-latency sample of a bucket of a few samples still has a
+    // significant jitter. The positions and times are relative to the
+    // first bucket to keep the sums small.
+    m_bucket_period = 0;
+    if (m_buckets.size() < 3)
+        return 0;
+
+    const SampleBucket& earliest = m_buckets.front();
+    double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+    int start = 0;
+    int x = 0;
+    size_t count = m_buckets.size() - 1;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const SampleBucket& bucket = m_buckets[i];
+        x = start + bucket.min_pos - earliest.min_pos;
+        double y = bucket.min_time - earliest.min_time;
+        sum_x += x;
+        sum_y += y;
+        sum_xx += static_cast<double>(x) * x;
+        sum_xy += x * y;
+        start += bucket.size;
+    }
+
+    // With few buckets, the samples can be close to each other, and the
+    // fit would then mostly measure their jitter
+    if (2 * x < static_cast<int>(m_bucket_slots))
+        return 0;
+
+    m_bucket_period = (count * sum_xy - sum_x * sum_y) / (count * sum_xx - sum_x * sum_x);
+    return m_bucket_period;
+}
+
+bool TimestampEstimator::hasPeriod() const
+{
+    if (!m_got_full_window && m_initial_period)
+        return true;
+    return (getWindowSize() - m_missing_samples) >= 2;
+}
 double TimestampEstimator::getPeriodInternal() const
 {
     if (!m_got_full_window && m_initial_period)
@@ -125,6 +211,20 @@ double TimestampEstimator::getPeriodInternal() const
         // initial period should be very slightly over-estimated (if possible).
         return m_initial_period;
     }
+    else if (m_bucket_duration > 0)
+    {
+        double period = getBucketPeriod();
+        if (period > 0)
+            return period;
+
+        // The last bucket always holds a valid sample, only placeholders
+        // after it have to be ignored
+        const SampleBucket& latest = m_buckets.back();
+        int count = m_bucket_slots - (latest.size - latest.last_pos - 1);
+        if (count <= 1)
+            throw std::logic_error("getPeriodInternal() called with no initial period and less than 2 valid samples");
+        return (latest.last - m_buckets.front().first) / (count - 1);
+    }
     else
     {
         int count = m_samples.size();
@@ -158,6 +258,21 @@ double TimestampEstimator::getPeriodInternal() const
 
 void TimestampEstimator::dumpInternalState() const
 {
+    if (m_bucket_duration > 0)
+    {
+        std::cout << m_bucket_slots << " samples in " << m_buckets.size() << " buckets" << std::endl;
+        std::cout << "  capacity=" << m_buckets.capacity() << std::endl;
+        std::cout << "  m_missing_samples=" << m_missing_samples << std::endl;
+        std::cout << "  m_missing_samples_total=" << m_missing_samples_total << std::endl;
+        circular_buffer<SampleBucket>::const_iterator it;
+        for (it = m_buckets.begin(); it != m_buckets.end(); ++it)
+        {
+            std::cout << it->first << " " << it->last << " size=" << it->size
+                << " last_pos=" << it->last_pos << " missing=" << it->missing << std::endl;
+        }
+        return;
+    }
+
     std::cout << m_samples.size() << " samples in buffer" << std::endl;
     std::cout << "  capacity=" << m_samples.capacity() << std::endl;
     std::cout << "  m_missing_samples=" << m_missing_samples << std::endl;
@@ -178,6 +293,9 @@ int TimestampEstimator::getLostSampleCount() const
 
 void TimestampEstimator::shortenSampleList(double current)
 {
+    if (m_bucket_duration > 0)
+        return shortenBucketList(current);
+
     if (haveEstimate())
     {
 	// Compute the period up to now for later reuse
@@ -247,6 +365,67 @@ void TimestampEstimator::shortenSampleList(double current)
     }
 }
 
+void TimestampEstimator::shortenBucketList(double current)
+{
+    if (haveEstimate())
+    {
+	double period = getPeriodInternal();
+	double min_time = current - m_window;
+
+        // Skip the buckets that start before the window
+        size_t window_begin = 0;
+        while (window_begin < m_buckets.size() && m_buckets[window_begin].first < min_time)
+            window_begin++;
+
+        if (m_buckets.front().first < min_time)
+            m_got_full_window = true;
+
+        if (m_buckets.back().last < min_time)
+        {
+            m_buckets.clear();
+            m_bucket_slots = 0;
+            m_bucket_period = -1;
+            m_missing_samples = 0;
+            return;
+        }
+        else if (window_begin == m_buckets.size())
+            window_begin--;
+
+        // Same burst gap search as in shortenSampleList, but only at the
+        // bucket boundaries
+        size_t begin = window_begin;
+        bool found_gap = false;
+        while (begin > 0 && !found_gap)
+        {
+            const SampleBucket& previous = m_buckets[begin - 1];
+            int distance = previous.size - previous.last_pos;
+            found_gap = ((m_buckets[begin].first - previous.last) / distance >= 0.5 * period);
+            begin--;
+        }
+
+	//if we didn't find anything, fall back to real window begin
+        if (!found_gap || begin == 0 || m_buckets[begin].first < min_time - m_window)
+            begin = window_begin;
+
+        for (size_t i = 0; i < begin; ++i)
+        {
+            m_bucket_slots -= m_buckets[i].size;
+            m_missing_samples -= m_buckets[i].missing;
+        }
+        m_buckets.erase(m_buckets.begin(), m_buckets.begin() + begin);
+        if (begin > 0)
+            m_bucket_period = -1;
+    }
+
+    if (m_bucket_slots == m_missing_samples)
+    {
+        m_buckets.clear();
+        m_bucket_slots = 0;
+        m_bucket_period = -1;
+        m_missing_samples = 0;
+    }
+}
+
 base::Time TimestampEstimator::update(base::Time time)
 {
     if (m_zero.isNull())
@@ -259,10 +438,14 @@ base::Time TimestampEstimator::update(base::Time time)
     shortenSampleList(current);
 
     // If there are no samples so far, reinitialize the state of the estimator
-    if (m_samples.empty())
+    if (getWindowSize() == 0)
     {
         resetBaseTime(current, current);
-        m_samples.push_back(current);
+        if (m_bucket_duration > 0)
+            pushBucketSample(current);
+        else
+            m_samples.push_back(current);
+        publishStatus();
         return base::Time::fromSeconds(m_last - m_latency) + m_zero;
     }
 
@@ -281,19 +464,41 @@ base::Time TimestampEstimator::update(base::Time time)
         double base_time_reset = current;
         int base_count = 0;
 
-        circular_buffer<double>::const_reverse_iterator it = m_samples.rbegin();
-        // This code works as
-        //      *it < base_time - base_count * period,
-        // means that
-        //      *it + period > base_time - (base_count - 1) * period
-        // i.e. the sample at *it has a lower jitter than the one at base_time
-        // and we therefore should use it as the new base time
-        for (++it, ++base_count; it != m_samples.rend(); ++it, ++base_count)
+        if (m_bucket_duration > 0)
+        {
+            // Same as below, using the least-latency sample of each
+            // bucket. bucket_count is the distance between the bucket's
+            // first position and the latest sample
+            int bucket_count = m_buckets.back().size - 1;
+            circular_buffer<SampleBucket>::const_reverse_iterator it;
+            for (it = m_buckets.rbegin(); it != m_buckets.rend(); ++it)
+            {
+                if (it != m_buckets.rbegin())
+                    bucket_count += it->size;
+                base_count = bucket_count - it->min_pos;
+                if (it->min_time < base_time - base_count * period)
+                {
+                    base_time = it->min_time + base_count * period;
+                    base_time_reset = it->min_time;
+                }
+            }
+        }
+        else
         {
-            if (!base::isUnset(*it) && (*it < base_time - base_count * period))
+            circular_buffer<double>::const_reverse_iterator it = m_samples.rbegin();
+            // This code works as
+            //      *it < base_time - base_count * period,
+            // means that
+            //      *it + period > base_time - (base_count - 1) * period
+            // i.e. the sample at *it has a lower jitter than the one at base_time
+            // and we therefore should use it as the new base time
+            for (++it, ++base_count; it != m_samples.rend(); ++it, ++base_count)
             {
-                base_time = *it + base_count * period;
-                base_time_reset = *it;
+                if (!base::isUnset(*it) && (*it < base_time - base_count * period))
+                {
+                    base_time = *it + base_count * period;
+                    base_time_reset = *it;
+                }
             }
         }
 
@@ -314,7 +519,8 @@ base::Time TimestampEstimator::update(base::Time time)
     // before we can detect a lost sample
     if (m_expected_loss_timeout == 0)
     {
-        m_rejected_expected_losses += m_expected_losses;
+        m_rejected_expected_losses = std::min<int64_t>(
+                static_cast<int64_t>(m_rejected_expected_losses) + m_expected_losses, INT_MAX);
         m_expected_losses = 0;
     }
     else
@@ -348,7 +554,15 @@ base::Time TimestampEstimator::update(base::Time time)
         }
     }
 
-    if (lost_count > 0)
+    if (lost_count > 0 && m_bucket_duration > 0)
+    {
+        insertBucketMissing(lost_count, period);
+        m_missing_samples += lost_count;
+        m_missing_samples_total += lost_count;
+        m_last += lost_count * period;
+        m_lost.clear();
+    }
+    else if (lost_count > 0)
     {
         m_samples.pop_back();
         for (int i = 0; i < lost_count; ++i)
@@ -378,11 +592,15 @@ base::Time TimestampEstimator::update(base::Time time)
 
     if (!m_last_reference.isNull())
         m_latency_raw = m_last - (m_last_reference - m_zero).toSeconds();
+    publishStatus();
     return base::Time::fromSeconds(m_last - m_latency) + m_zero;
 }
 
 void TimestampEstimator::pushSample(double current)
 {
+    if (m_bucket_duration > 0)
+        return pushBucketSample(current);
+
     // If we have an initial period, m_samples has been sized already. Since
     // push_back will override the beginning of the circular buffer, there is
     // nothing to do if the buffer is full
@@ -410,6 +628,81 @@ void TimestampEstimator::pushSample(double current)
     m_samples.push_back(current);
 }
 
+void TimestampEstimator::pushBucketSample(double current)
+{
+    // Once a period is available, buckets are closed based on their sample
+    // count instead of the sample time. Otherwise, the first sample of the
+    // buckets would be biased towards late samples, which would bias the
+    // period estimate.
+    double period = haveEstimate() ? getPeriodInternal() : 0;
+    bool new_bucket = m_buckets.empty();
+    if (!new_bucket && period > 0)
+        new_bucket = (m_buckets.back().size * period >= m_bucket_duration);
+    else if (!new_bucket)
+        new_bucket = (current - m_buckets.back().first >= m_bucket_duration);
+
+    if (new_bucket)
+    {
+        // The bucket count is bounded by the window, but the bucket that
+        // contains the window start is kept in addition to it
+        if (m_buckets.full())
+            m_buckets.set_capacity(20 + m_buckets.capacity());
+
+        SampleBucket bucket;
+        bucket.first = current;
+        bucket.last = current;
+        bucket.size = 1;
+        bucket.last_pos = 0;
+        bucket.missing = 0;
+        bucket.min_pos = 0;
+        bucket.min_time = current;
+        m_buckets.push_back(bucket);
+        m_bucket_period = -1;
+    }
+    else
+    {
+        SampleBucket& bucket = m_buckets.back();
+        bucket.last = current;
+        bucket.last_pos = bucket.size++;
+        if (current - bucket.last_pos * period < bucket.min_time - bucket.min_pos * period)
+        {
+            bucket.min_pos = bucket.last_pos;
+            bucket.min_time = current;
+        }
+    }
+    m_bucket_slots++;
+}
+
+void TimestampEstimator::insertBucketMissing(int count, double period)
+{
+    // The placeholders belong to the bucket of the valid sample before the
+    // last one
+    SampleBucket& latest = m_buckets.back();
+    if (latest.last_pos == 0 && m_buckets.size() > 1)
+    {
+        SampleBucket& previous = m_buckets[m_buckets.size() - 2];
+        previous.size += count;
+        previous.missing += count;
+        m_bucket_period = -1;
+    }
+    else
+    {
+        latest.size += count;
+        latest.missing += count;
+        if (latest.min_pos == latest.last_pos)
+            latest.min_pos += count;
+        latest.last_pos += count;
+        // Moving the last sample further in the bucket makes it look
+        // earlier, which can make it the least-latency sample
+        if (latest.last - latest.last_pos * period < latest.min_time - latest.min_pos * period)
+        {
+            latest.min_pos = latest.last_pos;
+            latest.min_time = latest.last;
+        }
+    }
+    m_bucket_slots += count;
+}
+
 void TimestampEstimator::resetBaseTime(double new_value, double reset_time)
 {
     if (m_last != 0)
@@ -422,10 +715,29 @@ void TimestampEstimator::resetBaseTime(double new_value, double reset_time)
 
 void TimestampEstimator::updateLoss()
 {
-    m_expected_losses++;
+    updateLoss(1);
+}
+
+void TimestampEstimator::updateLoss(int count)
+{
+    if (count <= 0)
+        return;
+
+    m_expected_losses = std::min<int64_t>(
+            static_cast<int64_t>(m_expected_losses) + count, INT_MAX);
     m_expected_loss_timeout = 10;
 }
 
+void TimestampEstimator::setIndexWidth(int bits)
+{
+    if (bits < 2 || bits > 64)
+        throw std::invalid_argument("TimestampEstimator::setIndexWidth: the width must be between 2 and 64 bits");
+    m_index_bits = bits;
+}
+
+int TimestampEstimator::getIndexResetCount() const
+{ return m_index_resets; }
+
 void TimestampEstimator::updateReference(base::Time ts)
 {
     if (!m_got_full_window)
@@ -451,27 +763,56 @@ void TimestampEstimator::updateReference(base::Time ts)
 bool TimestampEstimator::haveEstimate() const
 {
     if (m_initial_period)
-        return (m_samples.size() - m_missing_samples) >= 1;
+        return (getWindowSize() - m_missing_samples) >= 1;
     else
-        return (m_samples.size() - m_missing_samples) >= 2;
+        return (getWindowSize() - m_missing_samples) >= 2;
 }
 
 base::Time TimestampEstimator::update(base::Time time, int64_t index)
 {
-    if (!m_have_last_index || index <= m_last_index)
+    if (!m_have_last_index)
     {
 	m_have_last_index = true;
         m_last_index = index;
+        m_last_index_time = time;
         return update(time);
     }
 
-    int64_t lost = index - m_last_index - 1;
+    // Compute the index difference modulo the counter width, so that a
+    // wrapping counter looks like a normal increment. Differences of more
+    // than half the range are indexes going backwards.
+    uint64_t diff = static_cast<uint64_t>(index) - static_cast<uint64_t>(m_last_index);
+    uint64_t half_range = static_cast<uint64_t>(1) << (m_index_bits - 1);
+    if (m_index_bits < 64)
+        diff &= (static_cast<uint64_t>(1) << m_index_bits) - 1;
+
+    base::Time elapsed = time - m_last_index_time;
     m_last_index = index;
-    while(lost > 0)
+    m_last_index_time = time;
+
+    if (diff == 0)
+        return update(time);
+    else if (diff >= half_range)
     {
-	lost--;
-	updateLoss();
+        m_index_resets++;
+        return update(time);
+    }
+
+    uint64_t lost = diff - 1;
+    if (lost > 0 && haveEstimate())
+    {
+        // A device that resets its counter can make the index jump by a
+        // lot more than the samples that could have been lost in the
+        // elapsed time. Do not take such a jump as a loss.
+        double periods = elapsed.toSeconds() / getPeriodInternal();
+        if (lost > 2 * periods + m_lost_threshold + 10)
+        {
+            m_index_resets++;
+            return update(time);
+        }
     }
+
+    updateLoss(std::min<uint64_t>(lost, INT_MAX));
     return update(time);
 }
 
@@ -484,18 +825,27 @@ TimestampEstimatorStatus TimestampEstimator::getStatus() const
 {
     TimestampEstimatorStatus status;
     status.stamp = base::Time::fromSeconds(m_last - m_latency) + m_zero;
-    status.period = getPeriod();
+    if (hasPeriod())
+        status.period = getPeriod();
+    else
+        status.period = base::Time::fromSeconds(m_initial_period);
     status.latency = getLatency();
     status.lost_samples = m_missing_samples;
     status.lost_samples_total = m_missing_samples_total;
     status.expected_losses = m_expected_losses;
     status.rejected_expected_losses = m_rejected_expected_losses;
-    status.window_size = m_samples.size();
-    status.window_capacity = m_samples.capacity();
+    status.index_resets = m_index_resets;
+    status.window_size = getWindowSize();
+    if (m_bucket_duration > 0)
+        status.window_capacity = m_buckets.capacity();
+    else
+        status.window_capacity = m_samples.capacity();
     status.base_time = base::Time::fromSeconds(m_base_time_reset) + m_zero;
     status.base_time_reset_offset = base::Time::fromSeconds(m_base_time_reset_offset);
-    if (m_samples.empty())
+    if (getWindowSize() == 0)
         status.time_raw = base::Time();
+    else if (m_bucket_duration > 0)
+        status.time_raw = base::Time::fromSeconds(m_buckets.back().last) + m_zero;
     else
         status.time_raw = base::Time::fromSeconds(m_samples.back()) + m_zero;
 
@@ -503,6 +853,28 @@ TimestampEstimatorStatus TimestampEstimator::getStatus() const
     return status;
 }
 
+TimestampEstimatorStatus TimestampEstimator::getStatusSnapshot() const
+{
+    return m_snapshot.read();
+}
+
+void TimestampEstimator::enableStatusSnapshot()
+{
+    m_publish_status = true;
+    m_snapshot.write(getStatus());
+}
+
+void TimestampEstimator::disableStatusSnapshot()
+{
+    m_publish_status = false;
+}
+
+void TimestampEstimator::publishStatus()
+{
+    if (m_publish_status)
+        m_snapshot.write(getStatus());
+}
+
 std::ostream& aggregator::operator << (std::ostream& stream, TimestampEstimatorStatus const& status)
 {
     stream << "== Timestamp Estimator Status\n"
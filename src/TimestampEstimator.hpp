@@ -6,6 +6,7 @@
 #include <vector>
 
 #include <aggregator/TimestampEstimatorStatus.hpp>
+#include <aggregator/SeqLock.hpp>
 
 namespace aggregator
 {
@@ -32,6 +33,50 @@ namespace aggregator
 	 */
         boost::circular_buffer<double> m_samples;
 
+        /** Summary of a sub-interval of the window, used instead of
+         * m_samples when m_bucket_duration is non-zero
+         *
+         * A bucket is always started by a valid sample. Placeholders for lost
+         * samples are accounted in the bucket of the valid sample that
+         * precedes them.
+         */
+        struct SampleBucket
+        {
+            /** Time of the first sample in the bucket */
+            double first;
+            /** Time of the last valid sample in the bucket */
+            double last;
+            /** Count of samples in the bucket, including placeholders */
+            int size;
+            /** Position of the last valid sample in the bucket */
+            int last_pos;
+            /** Count of placeholders in the bucket */
+            int missing;
+            /** Position of the valid sample with the smallest
+             * (time - position * period), i.e. the sample with the least
+             * latency in the bucket
+             */
+            int min_pos;
+            /** The time of the sample at min_pos */
+            double min_time;
+        };
+
+        /** Duration of the buckets in m_buckets. Zero if the window is stored
+         * per-sample in m_samples
+         */
+        double m_bucket_duration;
+
+        /** Bucketed window, used when m_bucket_duration is non-zero */
+        boost::circular_buffer<SampleBucket> m_buckets;
+
+        /** Count of samples, including placeholders, summarized in m_buckets */
+        unsigned int m_bucket_slots;
+
+        /** Period fitted on m_buckets, see getBucketPeriod(). Negative if
+         * the buckets changed since it got computed
+         */
+        mutable double m_bucket_period;
+
         /** The last estimated timestamp, without latency
          *
          * The current best estimate for the next sample, with no new
@@ -125,6 +170,17 @@ namespace aggregator
 	/** m_last_index is initialized */
 	bool m_have_last_index;
 
+	/** the time given to update along with m_last_index */
+	base::Time m_last_index_time;
+
+	/** width in bits of the index counter given to update, which wraps
+	 * around at 2^m_index_bits */
+	int m_index_bits;
+
+	/** count of index jumps that were considered as resets of the
+	 * counter instead of losses */
+	int m_index_resets;
+
         /** The last time given to updateReference */
         base::Time m_last_reference;
 
@@ -143,6 +199,24 @@ namespace aggregator
          */
         int m_expected_loss_timeout;
 
+        /** The status as of the last call to update(), published for the
+         * readers of getStatusSnapshot()
+         */
+        SeqLock<TimestampEstimatorStatus> m_snapshot;
+
+        /** True if update() publishes the status in m_snapshot, see
+         * enableStatusSnapshot()
+         */
+        bool m_publish_status;
+
+        /** Publishes the current status in m_snapshot, if enabled */
+        void publishStatus();
+
+        /** Returns true if getPeriodInternal() can compute a period, i.e.
+         * will not throw
+         */
+        bool hasPeriod() const;
+
         /** Set the base time to the given value. reset_time is used in update()
          * to trigger new updates when necessary
          */
@@ -163,6 +237,29 @@ namespace aggregator
          */
         void pushSample(double time);
 
+        /** Version of pushSample for the bucketed window */
+        void pushBucketSample(double time);
+
+        /** Adds placeholders for \c count lost samples right before the last
+         * sample of the bucketed window
+         */
+        void insertBucketMissing(int count, double period);
+
+        /** Version of shortenSampleList for the bucketed window */
+        void shortenBucketList(double current);
+
+        /** Least-squares fit of the period through the least-latency sample
+         * of each complete bucket. The fit is cached until the buckets
+         * change.
+         *
+         * @return the period, or zero if the complete buckets do not cover
+         *   at least half of the window
+         */
+        double getBucketPeriod() const;
+
+        /** Count of samples, including placeholders, in the window */
+        unsigned int getWindowSize() const;
+
     public:
         /** Creates a timestamp estimator
          *
@@ -227,12 +324,50 @@ namespace aggregator
 
         /** Updates the estimate and return the actual timestamp for +ts+,
 	 *  calculating lost samples from the index
+	 *
+	 *  The index is handled as a counter of the width given to
+	 *  setIndexWidth(), i.e. wrapping around is not considered as a loss.
+	 *  An index going backwards, or jumping further than the time
+	 *  elapsed since the last index allows, is considered as a reset of
+	 *  the counter instead of as lost samples.
 	 */
 	base::Time update(base::Time ts, int64_t index);
 
         /** Updates the estimate for a known lost sample */
 	void updateLoss();
 
+        /** Updates the estimate for a known count of lost samples
+         *
+         * This is constant time regardless of the count. The count of
+         * expected losses saturates at INT_MAX.
+         */
+	void updateLoss(int count);
+
+        /** Sets the width in bits of the index given to update(), for
+         * counters that wrap around. The default is 64, i.e. the index is
+         * not expected to wrap.
+         */
+	void setIndexWidth(int bits);
+
+        /** The count of index jumps which were considered to be resets of
+         * the index counter
+         */
+        int getIndexResetCount() const;
+
+        /** Summarizes the estimation window in buckets of the given duration
+         * instead of storing one timestamp per sample
+         *
+         * This bounds the memory and the processing time of very high-rate
+         * streams to window / bucket_duration. The period, base time and
+         * burst gaps are then estimated with an error bounded by the bucket
+         * duration. Buckets should hold at least a few samples, as the
+         * period is estimated from the least-latency sample of each bucket.
+         * Zero (the default) stores every sample.
+         *
+         * This resets the estimator
+         */
+        void setWindowBucketDuration(base::Time bucket_duration);
+
         /** Updates the estimate using a reference */
 	void updateReference(base::Time ts);
 
@@ -266,10 +401,36 @@ namespace aggregator
         /** Returns a data structure that represents the estimator's internal
          * status
          *
-         * This is constant time
+         * This is constant time. The period is the initial period (or zero)
+         * as long as the estimator cannot compute it.
          */
         TimestampEstimatorStatus getStatus() const;
 
+        /** Makes update() and reset() publish the status for
+         * getStatusSnapshot(), and publishes the current status
+         *
+         * Publishing builds the complete status on every update, which is
+         * why it is disabled by default. It must be called from the thread
+         * that calls update(). The setting is kept across reset().
+         */
+        void enableStatusSnapshot();
+
+        /** Stops publishing the status. getStatusSnapshot() keeps returning
+         * the last published status
+         */
+        void disableStatusSnapshot();
+
+        /** Returns the status as of the last call to update() or reset()
+         *
+         * Unlike the other accessors, this can be called from other threads
+         * than the one calling update(). It does not lock, and never blocks
+         * the updating thread.
+         *
+         * The status is published only once enableStatusSnapshot() has been
+         * called. Until then, this returns a default-constructed status.
+         */
+        TimestampEstimatorStatus getStatusSnapshot() const;
+
         /** Dumps part of the estimator's internal state to std::cout
          */
         void dumpInternalState() const;
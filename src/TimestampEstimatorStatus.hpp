@@ -34,7 +34,8 @@ namespace aggregator {
         /** Count of samples currently stored in the estimator
          */
         int window_size;
-        /** Maximum window capacity
+        /** Maximum window capacity, in buckets if the estimator's window
+         * is bucketed
          */
         int window_capacity;
         /** Time at which the base time got reset last
@@ -51,9 +52,13 @@ namespace aggregator {
          * the estimator
          */
         int rejected_expected_losses;
+        /** The number of index jumps given to update() that were considered
+         * to be resets of the index counter instead of losses
+         */
+        int index_resets;
 
         TimestampEstimatorStatus()
-            : lost_samples(0) {}
+            : lost_samples(0), index_resets(0) {}
     };
 
     std::ostream& operator << (std::ostream& stream, TimestampEstimatorStatus const& status);
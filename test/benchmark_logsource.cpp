@@ -0,0 +1,161 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <aggregator/PullStreamAligner.hpp>
+#include <aggregator/AsyncLogSource.hpp>
+
+using namespace aggregator;
+using namespace std;
+
+/** Measures the throughput of replaying a log file through a
+ * PullStreamAligner, decoding the records from a memory mapping and from an
+ * AsyncLogSource with each of its backends.
+ *
+ * The file is read once before the measurements, so all of them run from
+ * the page cache unless the file is larger than the memory.
+ */
+
+static const size_t RECORD_SIZE = 64;
+
+double sum = 0;
+
+void sample_callback( const base::Time &time, const double &value )
+{
+    sum += value;
+}
+
+/** records are RECORD_SIZE bytes: time in microseconds, value, padding */
+size_t decode_record( const ByteSpan &data, base::Time &time, double &value )
+{
+    if( data.size() < RECORD_SIZE )
+	return 0;
+    uint64_t us;
+    memcpy( &us, data.begin(), sizeof(us) );
+    memcpy( &value, data.begin() + sizeof(us), sizeof(value) );
+    time = base::Time::fromMicroseconds( us );
+    return RECORD_SIZE;
+}
+
+void write_log( const std::string &path, size_t count )
+{
+    FILE *file = fopen( path.c_str(), "w" );
+    if( !file )
+    {
+	cerr << "cannot create " << path << endl;
+	exit( 1 );
+    }
+    uint8_t record[RECORD_SIZE];
+    memset( record, 0, sizeof(record) );
+    for( size_t i = 0; i < count; i++ )
+    {
+	uint64_t us = 1000 * i;
+	double value = i;
+	memcpy( record, &us, sizeof(us) );
+	memcpy( record + sizeof(us), &value, sizeof(value) );
+	fwrite( record, sizeof(record), 1, file );
+    }
+    fclose( file );
+}
+
+struct MappedSource
+{
+    const uint8_t *data;
+    size_t size;
+    size_t offset;
+
+    bool pull( base::Time &time, double &value )
+    {
+	size_t used = decode_record( ByteSpan( data + offset, size - offset ), time, value );
+	offset += used;
+	return used != 0;
+    }
+};
+
+/** replays the log from a memory mapping
+ *
+ * @result - MB per second
+ */
+double runMapped( const std::string &path )
+{
+    int fd = open( path.c_str(), O_RDONLY );
+    struct stat info;
+    fstat( fd, &info );
+    void *data = mmap( 0, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    madvise( data, info.st_size, MADV_SEQUENTIAL );
+
+    MappedSource source;
+    source.data = static_cast<const uint8_t*>( data );
+    source.size = info.st_size;
+    source.offset = 0;
+
+    base::Time start = base::Time::now();
+    PullStreamAligner aligner;
+    aligner.setTimeout( base::Time::fromSeconds( 1.0 ) );
+    aligner.registerStream<double>( boost::bind( &MappedSource::pull, &source, _1, _2 ),
+	    &sample_callback, 64, base::Time::fromMicroseconds( 1000 ) );
+    while( aligner.pull() )
+	while( aligner.step() );
+    while( aligner.step() );
+    double duration = (base::Time::now() - start).toSeconds();
+
+    munmap( data, info.st_size );
+    close( fd );
+    return info.st_size / duration / 1e6;
+}
+
+/** replays the log from an AsyncLogSource
+ *
+ * @result - MB per second
+ */
+double runAsync( const std::string &path, const AsyncFileReader::Config &config, bool &io_uring )
+{
+    base::Time start = base::Time::now();
+    AsyncLogSource<double> source( path, &decode_record, RECORD_SIZE, config );
+    io_uring = source.getReader().usesIoUring();
+
+    PullStreamAligner aligner;
+    aligner.setTimeout( base::Time::fromSeconds( 1.0 ) );
+    aligner.registerStream<double>( boost::bind( &AsyncLogSource<double>::pull, &source, _1, _2 ),
+	    &sample_callback, 64, base::Time::fromMicroseconds( 1000 ) );
+    while( aligner.pull() )
+	while( aligner.step() );
+    while( aligner.step() );
+    double duration = (base::Time::now() - start).toSeconds();
+
+    return source.getReader().fileSize() / duration / 1e6;
+}
+
+int main( int argc, char **argv )
+{
+    size_t megabytes = argc > 1 ? atoi( argv[1] ) : 256;
+    std::string path = argc > 2 ? argv[2] : "/tmp/aggregator-logsource-benchmark.log";
+
+    write_log( path, megabytes * 1000000 / RECORD_SIZE );
+    runMapped( path );
+
+    cout << "mmap: " << runMapped( path ) << " MB/s" << endl;
+
+    AsyncFileReader::Config config;
+    config.use_io_uring = false;
+    bool io_uring;
+    cout << "thread pool: " << runAsync( path, config, io_uring ) << " MB/s" << endl;
+
+    config.use_io_uring = true;
+    double rate = runAsync( path, config, io_uring );
+    if( io_uring )
+	cout << "io_uring: " << rate << " MB/s" << endl;
+    else
+	cout << "io_uring: not available" << endl;
+
+    unlink( path.c_str() );
+
+    // keep the callbacks from being optimized out
+    return sum < 0;
+}
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <cstdlib>
+
+#include <aggregator/StreamAligner.hpp>
+
+using namespace aggregator;
+using namespace std;
+
+/** Measures the throughput of a StreamAligner merging several streams of
+ * small samples. The program is built once with the status bookkeeping and
+ * once with AGGREGATOR_DISABLE_STATUS, to compare both.
+ */
+
+double sum = 0;
+
+void sample_callback( const base::Time &time, const double &value )
+{
+    sum += value;
+}
+
+/** pushes count samples into each of the streams and steps through them,
+ * interleaved so that the buffers stay small
+ *
+ * @result - merged samples per second
+ */
+double runMerge( size_t streamCount, size_t count )
+{
+    StreamAligner aligner;
+    aligner.setTimeout( base::Time::fromSeconds( 1.0 ) );
+
+    std::vector<int> streams;
+    for( size_t i = 0; i < streamCount; i++ )
+	streams.push_back( aligner.registerStream<double>( &sample_callback, 64, base::Time::fromMicroseconds( 1000 ) ) );
+
+    base::Time start = base::Time::now();
+    for( size_t i = 0; i < count; i++ )
+    {
+	for( size_t j = 0; j < streamCount; j++ )
+	    aligner.push( streams[j], base::Time::fromMicroseconds( 1000 * i + j + 1 ), double( i ) );
+	while( aligner.step() );
+    }
+    double duration = (base::Time::now() - start).toSeconds();
+
+    return streamCount * count / duration;
+}
+
+/** same as runMerge() with compressed streams, which adds the cost of the
+ * coding of the samples
+ *
+ * @result - merged samples per second
+ */
+double runCompressedMerge( size_t streamCount, size_t count )
+{
+    StreamAligner aligner;
+    aligner.setTimeout( base::Time::fromSeconds( 1.0 ) );
+
+    std::vector<int> streams;
+    for( size_t i = 0; i < streamCount; i++ )
+	streams.push_back( aligner.registerCompressedStream<double>( &sample_callback, 4096, base::Time::fromMicroseconds( 1000 ) ) );
+
+    base::Time start = base::Time::now();
+    for( size_t i = 0; i < count; i++ )
+    {
+	for( size_t j = 0; j < streamCount; j++ )
+	    aligner.push( streams[j], base::Time::fromMicroseconds( 1000 * i + j + 1 ), double( i ) );
+	while( aligner.step() );
+    }
+    double duration = (base::Time::now() - start).toSeconds();
+
+    return streamCount * count / duration;
+}
+
+/** buffers count samples of a slowly changing value, sampled with some
+ * jitter, in a compressed stream
+ *
+ * @result - buffer memory per sample, in bytes
+ */
+double compressedBytes( size_t count )
+{
+    StreamAligner::CompressedStream<double> stream( &sample_callback, 1 << 22, base::Time::fromMicroseconds( 1000 ), 0, "compressed" );
+    for( size_t i = 0; i < count; i++ )
+	stream.pushInput( base::Time::fromMicroseconds( 1000 * i + (i * 7919) % 50 ), 20.0 + 0.125 * (i / 100) );
+    return double( stream.getBufferStatus().buffer_fill ) / count;
+}
+
+int main( int argc, char **argv )
+{
+    size_t count = argc > 1 ? atoi( argv[1] ) : 1000000;
+
+#ifdef AGGREGATOR_DISABLE_STATUS
+    cout << "status bookkeeping: disabled" << endl;
+#else
+    cout << "status bookkeeping: enabled" << endl;
+#endif
+
+    size_t streamCounts[] = { 1, 4, 16 };
+    for( size_t i = 0; i < sizeof(streamCounts) / sizeof(streamCounts[0]); i++ )
+    {
+	cout << streamCounts[i] << " streams: " 
+	    << runMerge( streamCounts[i], count / streamCounts[i] ) << " samples/s" << endl;
+    }
+
+    for( size_t i = 0; i < sizeof(streamCounts) / sizeof(streamCounts[0]); i++ )
+    {
+	cout << streamCounts[i] << " compressed streams: " 
+	    << runCompressedMerge( streamCounts[i], count / streamCounts[i] ) << " samples/s" << endl;
+    }
+
+    cout << "buffer memory per sample: " << sizeof(base::Time) + sizeof(double) << " bytes plain, "
+	<< compressedBytes( 100000 ) << " bytes compressed" << endl;
+
+    // keep the callbacks from being optimized out
+    return sum < 0;
+}
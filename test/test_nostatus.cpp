@@ -0,0 +1,145 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE "test_nostatus"
+#define BOOST_AUTO_TEST_MAIN
+
+// This suite is built with AGGREGATOR_DISABLE_STATUS, and checks that the
+// streams behave the same without the status updates. It must therefore not
+// look at the status counters.
+
+#include <boost/test/unit_test.hpp>
+
+#include <aggregator/StreamAligner.hpp>
+#include <string>
+#include <vector>
+
+using namespace aggregator;
+using namespace std;
+
+#ifndef AGGREGATOR_DISABLE_STATUS
+#error "test_nostatus must be built with AGGREGATOR_DISABLE_STATUS"
+#endif
+
+// events seen by the default cursor and by the added cursor
+vector<double> events[2];
+
+template <int C> void tick_callback( const base::Time &time )
+{
+    events[C].push_back( -time.toSeconds() );
+}
+
+template <int C> void string_callback( const base::Time &time, const string &sample )
+{
+    events[C].push_back( time.toSeconds() );
+}
+
+template <int C> void packet_callback( const base::Time &time, const ByteSpan &packet )
+{
+    events[C].push_back( time.toSeconds() );
+    events[C].push_back( packet.size() );
+}
+
+template <int C> void reduction_callback( const base::Time &time, const ReductionSummary<double> &summary )
+{
+    events[C].push_back( time.toSeconds() );
+    events[C].push_back( summary.max );
+}
+
+template <int C> void double_callback( const base::Time &time, const double &value )
+{
+    events[C].push_back( time.toSeconds() );
+    events[C].push_back( value );
+}
+
+void clearEvents()
+{
+    events[0].clear();
+    events[1].clear();
+}
+
+/** steps both cursors to the end and checks that they saw the same events */
+void replay( StreamAligner &reader, int cursor, size_t expected )
+{
+    while( reader.step() );
+    while( reader.step( cursor ) );
+    BOOST_REQUIRE_EQUAL( events[0].size(), expected );
+    BOOST_REQUIRE_EQUAL( events[1].size(), expected );
+    for( size_t i = 0; i < expected; ++i )
+	BOOST_CHECK_EQUAL( events[0][i], events[1][i] );
+}
+
+BOOST_AUTO_TEST_CASE( tick_stream_cursor_test )
+{
+    StreamAligner reader;
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+    int slow = reader.addCursor( base::Time::fromSeconds(10.0) );
+
+    int s1 = reader.registerStream<string>( &string_callback<0>, 8, base::Time::fromSeconds(0.5) );
+    int t1 = reader.registerTickStream( &tick_callback<0>, base::Time::fromSeconds(0.5), 1 );
+    reader.setCursorCallback<string>( slow, s1, &string_callback<1> );
+    reader.setCursorTickCallback( slow, t1, &tick_callback<1> );
+
+    for( int i = 0; i < 4; ++i )
+	reader.push( s1, base::Time::fromSeconds(1.2 + 0.5 * i), string("a") );
+
+    // 4 samples and the ticks at 1.5, 2.0 and 2.5
+    clearEvents();
+    replay( reader, slow, 7 );
+    BOOST_CHECK_CLOSE( events[1][1], -1.5, 1e-6 );
+    BOOST_CHECK_CLOSE( events[1][5], -2.5, 1e-6 );
+}
+
+BOOST_AUTO_TEST_CASE( packet_stream_cursor_test )
+{
+    StreamAligner reader;
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+    int slow = reader.addCursor( base::Time::fromSeconds(10.0) );
+
+    int s1 = reader.registerPacketStream( &packet_callback<0>, 256, base::Time::fromSeconds(1) );
+    reader.setCursorCallback( slow, s1, &packet_callback<1> );
+
+    for( int i = 0; i < 4; ++i )
+	reader.pushPacket( s1, base::Time::fromSeconds(1.0 + i), string( i + 1, 'p' ) );
+
+    clearEvents();
+    replay( reader, slow, 8 );
+    BOOST_CHECK_EQUAL( events[1][7], 4 );
+}
+
+BOOST_AUTO_TEST_CASE( reduction_stream_cursor_test )
+{
+    StreamAligner reader;
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+    int slow = reader.addCursor( base::Time::fromSeconds(10.0) );
+
+    int s1 = reader.registerReductionStream<double, ReductionSummary<double> >( &ReductionSummary<double>::fold, ReductionSummary<double>(),
+	    base::Time::fromSeconds(1.0), &reduction_callback<0>, 4 );
+    reader.setCursorCallback<ReductionSummary<double> >( slow, s1, &reduction_callback<1> );
+
+    for( int i = 0; i < 8; ++i )
+	reader.push( s1, base::Time::fromSeconds(1.25 + 0.5 * i), double( i ) );
+    reader.flushStream( s1 );
+
+    // buckets [1,2), [2,3), [3,4) and [4,5), the last one being flushed
+    clearEvents();
+    replay( reader, slow, 8 );
+    BOOST_CHECK_EQUAL( events[1][1], 1.0 );
+    BOOST_CHECK_EQUAL( events[1][7], 7.0 );
+}
+
+BOOST_AUTO_TEST_CASE( compressed_stream_cursor_test )
+{
+    StreamAligner reader;
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+    int slow = reader.addCursor( base::Time::fromSeconds(10.0) );
+
+    int s1 = reader.registerCompressedStream<double>( &double_callback<0>, 4096, base::Time::fromMilliseconds(10) );
+    reader.setCursorCallback<double>( slow, s1, &double_callback<1> );
+
+    for( int i = 0; i < 100; ++i )
+	reader.push( s1, base::Time::fromMilliseconds(1000 + 10 * i), double( i ) );
+
+    clearEvents();
+    replay( reader, slow, 200 );
+    BOOST_CHECK_EQUAL( events[1][199], 99 );
+}
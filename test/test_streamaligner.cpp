@@ -5,6 +5,7 @@
 
 #include <iostream>
 #include <numeric>
+#include <deque>
 
 #include <boost/bind.hpp>
 #include <boost/test/unit_test.hpp>
@@ -12,10 +13,48 @@
 
 #include <aggregator/StreamAligner.hpp>
 #include <aggregator/PullStreamAligner.hpp>
+#include <aggregator/FanOutStreamAligner.hpp>
+#include <aggregator/AsyncLogSource.hpp>
+#include <aggregator/ColumnarBatch.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
 
 using namespace aggregator;
 using namespace std;
 
+// count the allocations of the whole test program, to check the real-time
+// mode of the stream aligner
+size_t allocationCount = 0;
+
+void* operator new( size_t size )
+{
+    allocationCount++;
+    void *ptr = malloc( size ? size : 1 );
+    if( !ptr )
+	throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[]( size_t size )
+{
+    return operator new( size );
+}
+
+// not inlined, as the compiler would otherwise complain about memory from
+// operator new being released with free() at the call sites
+__attribute__((noinline)) void operator delete( void *ptr )
+{
+    free( ptr );
+}
+
+void operator delete[]( void *ptr )
+{
+    operator delete( ptr );
+}
+
 string lastSample;
 
 void test_callback( const base::Time &time, const string& sample )
@@ -440,3 +479,1334 @@ BOOST_AUTO_TEST_CASE( pull_stream_test )
     lastSample = ""; reader.step(); BOOST_CHECK_EQUAL( lastSample, "b" );
 }
 
+// clock advancing by one millisecond per call
+base::Time pull_clock_time;
+base::Time step_pull_clock()
+{
+    pull_clock_time = pull_clock_time + base::Time::fromMilliseconds(1);
+    return pull_clock_time;
+}
+
+BOOST_AUTO_TEST_CASE( pull_stream_status_test )
+{
+    PullStreamAligner reader;
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+    reader.enablePullTiming( &step_pull_clock );
+
+    pull_object<string> p1;
+    pull_object<string> p2;
+
+    int s1 = reader.registerStream<string>( boost::bind( &pull_object<string>::getNext, &p1, _1, _2 ), &test_callback, 4, base::Time::fromSeconds(2), -1, "fast" );
+    int s2 = reader.registerStream<string>( boost::bind( &pull_object<string>::getNext, &p2, _1, _2 ), &test_callback, 4, base::Time::fromSeconds(2), 1, "slow" );
+
+    BOOST_CHECK_EQUAL( reader.getStatus().streams[s1].name, "fast" );
+    BOOST_CHECK_EQUAL( reader.getPullStatus( s2 ).name, "slow" );
+    BOOST_CHECK_EQUAL( reader.getPullStatus( s2 ).index, s2 );
+
+    p1.setNext( base::Time::fromSeconds(3.0), string("b") );
+    p2.setNext( base::Time::fromSeconds(1.0), string("a") );
+    while( reader.pull() );
+    lastSample = ""; reader.step(); BOOST_CHECK_EQUAL( lastSample, "a" );
+
+    // the first round of pulls read both samples. The second one pulled
+    // only the source that had pushed its sample, the third one both, and
+    // both found no data
+    const PullSourceStatus &slow( reader.getPullStatus( s2 ) );
+    BOOST_CHECK_EQUAL( slow.pulls, 3u );
+    BOOST_CHECK_EQUAL( slow.empty_pulls, 2u );
+    BOOST_CHECK_EQUAL( slow.records, 1u );
+    BOOST_CHECK( slow.lead == base::Time() );
+    BOOST_CHECK( !slow.pending );
+    BOOST_CHECK( slow.pull_time_max == base::Time::fromMilliseconds(1) );
+
+    const PullSourceStatus &fast( reader.getPullStatus( s1 ) );
+    BOOST_CHECK_EQUAL( fast.pulls, 2u );
+    BOOST_CHECK_EQUAL( fast.empty_pulls, 1u );
+    BOOST_CHECK_EQUAL( fast.records, 1u );
+    BOOST_CHECK( fast.lead == base::Time::fromSeconds(2.0) );
+
+    BOOST_CHECK_THROW( reader.getPullStatus( 2 ), std::runtime_error );
+
+    // clear() resets the statistics of the sources too
+    reader.clear();
+    BOOST_CHECK_EQUAL( reader.getPullStatus( s2 ).pulls, 0u );
+    BOOST_CHECK_EQUAL( reader.getPullStatus( s2 ).empty_pulls, 0u );
+    BOOST_CHECK_EQUAL( reader.getPullStatus( s1 ).records, 0u );
+    BOOST_CHECK( reader.getPullStatus( s1 ).lead == base::Time() );
+    BOOST_CHECK( reader.getPullStatus( s2 ).pull_time_max == base::Time() );
+}
+
+
+// log records: time in microseconds, payload length and payload, the first
+// four payload bytes holding the sample value
+size_t decode_log_record( const ByteSpan &data, base::Time &time, int &sample )
+{
+    uint64_t us;
+    uint32_t length;
+    if( data.size() < sizeof(us) + sizeof(length) )
+	return 0;
+    memcpy( &us, data.begin(), sizeof(us) );
+    memcpy( &length, data.begin() + sizeof(us), sizeof(length) );
+    size_t record = sizeof(us) + sizeof(length) + length;
+    if( data.size() < record )
+	return 0;
+    time = base::Time::fromMicroseconds( us );
+    memcpy( &sample, data.begin() + sizeof(us) + sizeof(length), sizeof(sample) );
+    return record;
+}
+
+std::string write_log_file( int count, int first_ms )
+{
+    char path[] = "/tmp/aggregator-log-XXXXXX";
+    int fd = mkstemp( path );
+    BOOST_REQUIRE( fd >= 0 );
+    FILE *file = fdopen( fd, "w" );
+    std::vector<uint8_t> payload( 512 );
+    for( int i = 0; i < count; ++i )
+    {
+	uint64_t us = (first_ms + 2 * i) * 1000;
+	uint32_t length = 4 + (i * 37) % 300;
+	int value = first_ms + 2 * i;
+	memcpy( &payload[0], &value, sizeof(value) );
+	fwrite( &us, sizeof(us), 1, file );
+	fwrite( &length, sizeof(length), 1, file );
+	fwrite( &payload[0], length, 1, file );
+    }
+    fclose( file );
+    return path;
+}
+
+struct log_collector
+{
+    void callback( const base::Time &time, const int &sample )
+    {
+	samples.push_back( sample );
+    }
+    std::vector<int> samples;
+};
+
+BOOST_AUTO_TEST_CASE( async_log_source_test )
+{
+    std::string even = write_log_file( 2000, 0 );
+    std::string odd = write_log_file( 2000, 1 );
+
+    // all combinations of io_uring and O_DIRECT. The files do not end on a
+    // page boundary, so that O_DIRECT reads the last page partially
+    for( int mode = 0; mode < 4; ++mode )
+    {
+	// small blocks so that many records span two blocks
+	AsyncFileReader::Config config;
+	config.block_size = 4096;
+	config.queue_depth = 4;
+	config.use_io_uring = mode & 1;
+	config.direct = mode & 2;
+	AsyncLogSource<int> s1( even, &decode_log_record, 512, config );
+	AsyncLogSource<int> s2( odd, &decode_log_record, 512, config );
+
+	PullStreamAligner reader;
+	reader.setTimeout( base::Time::fromSeconds(1.0) );
+	log_collector collector;
+	reader.registerStream<int>( boost::bind( &AsyncLogSource<int>::pull, &s1, _1, _2 ),
+		boost::bind( &log_collector::callback, &collector, _1, _2 ), 10, base::Time::fromMilliseconds(2) );
+	reader.registerStream<int>( boost::bind( &AsyncLogSource<int>::pull, &s2, _1, _2 ),
+		boost::bind( &log_collector::callback, &collector, _1, _2 ), 10, base::Time::fromMilliseconds(2) );
+
+	while( reader.pull() )
+	    while( reader.step() );
+	while( reader.step() );
+
+	BOOST_CHECK_EQUAL( 2000u, s1.getRecordCount() );
+	BOOST_CHECK_EQUAL( 2000u, s2.getRecordCount() );
+	BOOST_REQUIRE_EQUAL( 4000u, collector.samples.size() );
+	for( int i = 0; i < 4000; ++i )
+	    BOOST_REQUIRE_EQUAL( i, collector.samples[i] );
+    }
+
+    unlink( even.c_str() );
+    unlink( odd.c_str() );
+}
+
+struct subscriber_object
+{
+    void callback( const base::Time &time, const boost::shared_ptr<const string>& sample )
+    {
+	samples.push_back( *sample );
+	handles.push_back( sample.get() );
+    }
+
+    std::vector<string> samples;
+    std::vector<const string*> handles;
+};
+
+BOOST_AUTO_TEST_CASE( fan_out_test )
+{
+    FanOutStreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+
+    int s1 = reader.registerStream<string>( 4, base::Time::fromSeconds(2) ); 
+    int s2 = reader.registerStream<string>( 4, base::Time::fromSeconds(2), 1 );
+
+    subscriber_object o1, o2;
+    int sub1 = reader.subscribe( 10 );
+    int sub2 = reader.subscribe( 2 );
+    reader.setSubscriberCallback<string>( sub1, s1, boost::bind( &subscriber_object::callback, &o1, _1, _2 ) );
+    reader.setSubscriberCallback<string>( sub1, s2, boost::bind( &subscriber_object::callback, &o1, _1, _2 ) );
+    reader.setSubscriberCallback<string>( sub2, s1, boost::bind( &subscriber_object::callback, &o2, _1, _2 ) );
+    reader.setSubscriberCallback<string>( sub2, s2, boost::bind( &subscriber_object::callback, &o2, _1, _2 ) );
+
+    reader.push( s1, base::Time::fromSeconds(1.0), string("a") ); 
+    reader.push( s1, base::Time::fromSeconds(3.0), string("c") ); 
+    reader.push( s2, base::Time::fromSeconds(2.0), string("b") ); 
+    reader.push( s2, base::Time::fromSeconds(3.0), string("d") ); 
+    reader.push( s2, base::Time::fromSeconds(4.0), boost::shared_ptr<const string>( new string("f") ) ); 
+    reader.push( s1, base::Time::fromSeconds(4.0), string("e") ); 
+
+    while( reader.step( sub1 ) );
+
+    const char* expected[] = { "a", "b", "c", "d", "e", "f" };
+    BOOST_REQUIRE_EQUAL( o1.samples.size(), 6 );
+    for( int i = 0; i < 6; i++ )
+	BOOST_CHECK_EQUAL( o1.samples[i], expected[i] );
+
+    // the second subscriber only keeps the last two samples
+    BOOST_CHECK_EQUAL( reader.getSubscriberStatus( sub2 ).lag, 2 );
+    BOOST_CHECK_EQUAL( reader.getSubscriberStatus( sub2 ).samples_dropped_lag, 4 );
+    while( reader.step( sub2 ) );
+    BOOST_REQUIRE_EQUAL( o2.samples.size(), 2 );
+    BOOST_CHECK_EQUAL( o2.samples[0], "e" );
+    BOOST_CHECK_EQUAL( o2.samples[1], "f" );
+
+    // both subscribers got the very same sample instances
+    BOOST_CHECK_EQUAL( o1.handles[4], o2.handles[0] );
+    BOOST_CHECK_EQUAL( o1.handles[5], o2.handles[1] );
+    BOOST_CHECK_EQUAL( reader.getSubscriberStatus( sub1 ).samples_delivered, 6 );
+    BOOST_CHECK_EQUAL( reader.getSubscriberStatus( sub2 ).lag, 0 );
+}
+
+size_t fanOutTicks = 0;
+void fan_out_tick_callback( const base::Time &time )
+{
+    fanOutTicks++;
+}
+
+BOOST_AUTO_TEST_CASE( fan_out_foreign_stream_test )
+{
+    FanOutStreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+
+    int s1 = reader.registerStream<string>( 4, base::Time::fromSeconds(2) ); 
+    reader.registerTickStream( &fan_out_tick_callback, base::Time::fromSeconds(0.5) );
+
+    subscriber_object o1;
+    int sub1 = reader.subscribe( 10 );
+    reader.setSubscriberCallback<string>( sub1, s1, boost::bind( &subscriber_object::callback, &o1, _1, _2 ) );
+
+    // the ticks in between the samples do not reach the subscriber
+    reader.push( s1, base::Time::fromSeconds(1.0), string("a") ); 
+    reader.push( s1, base::Time::fromSeconds(3.0), string("b") ); 
+    while( reader.step( sub1 ) );
+    BOOST_REQUIRE_EQUAL( o1.samples.size(), 2 );
+    BOOST_CHECK_EQUAL( o1.samples[1], "b" );
+    BOOST_CHECK( fanOutTicks >= 4 );
+
+    // without subscriber, stepping releases the merged samples
+    reader.unsubscribe( sub1 );
+    boost::shared_ptr<const string> sample( new string("c") );
+    reader.push( s1, base::Time::fromSeconds(5.0), sample ); 
+    while( reader.step() );
+    BOOST_CHECK_EQUAL( sample.use_count(), 1 );
+}
+
+vector<string> cursorSamples;
+
+void cursor_callback( const base::Time &time, const string& sample )
+{
+    cursorSamples.push_back( sample );
+}
+
+BOOST_AUTO_TEST_CASE( cursor_test )
+{
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+    int slow = reader.addCursor( base::Time::fromSeconds(10.0) );
+
+    int s1 = reader.registerStream<string>( &test_callback, 10, base::Time::fromSeconds(1) ); 
+    int s2 = reader.registerStream<string>( &test_callback, 10, base::Time::fromSeconds(1) ); 
+    reader.setCursorCallback<string>( slow, s1, &cursor_callback );
+    reader.setCursorCallback<string>( slow, s2, &cursor_callback );
+
+    reader.push( s1, base::Time::fromSeconds(1.0), string("a") ); 
+    reader.push( s1, base::Time::fromSeconds(2.0), string("b") ); 
+    reader.push( s1, base::Time::fromSeconds(3.0), string("c") ); 
+    reader.push( s1, base::Time::fromSeconds(4.0), string("d") ); 
+
+    // the first cursor times out on s2, the slow one waits
+    lastSample = ""; reader.step(); BOOST_CHECK_EQUAL( lastSample, "a" );
+    lastSample = ""; reader.step(); BOOST_CHECK_EQUAL( lastSample, "b" );
+    lastSample = ""; reader.step(); BOOST_CHECK_EQUAL( lastSample, "c" );
+    lastSample = ""; reader.step(); BOOST_CHECK_EQUAL( lastSample, "" );
+    cursorSamples.clear();
+    BOOST_CHECK( reader.step( slow ) );
+    BOOST_CHECK( !reader.step( slow ) );
+    // a is released, since both cursors consumed it
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).buffer_fill, 3 );
+
+    // too late for the first cursor, but not for the slow one
+    reader.push( s2, base::Time::fromSeconds(2.5), string("x") ); 
+    BOOST_CHECK_EQUAL( reader.getSamplesDroppedLateArriving( 0 ), 1 );
+    BOOST_CHECK_EQUAL( reader.getSamplesDroppedLateArriving( slow ), 0 );
+
+    while( reader.step( slow ) );
+    const char* expected[] = { "a", "b", "x", "c" };
+    BOOST_REQUIRE_EQUAL( cursorSamples.size(), 4 );
+    for( int i = 0; i < 4; i++ )
+	BOOST_CHECK_EQUAL( cursorSamples[i], expected[i] );
+    BOOST_CHECK_EQUAL( reader.getCurrentTime( slow ).toSeconds(), 3.0 );
+    BOOST_CHECK_EQUAL( reader.getCurrentTime().toSeconds(), 3.0 );
+
+    // only the samples consumed by both cursors are released
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).buffer_fill, 1 );
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).samples_processed, 3 );
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s2 ).buffer_fill, 0 );
+}
+
+double lastValue;
+
+void value_callback( const base::Time &time, const double& sample )
+{
+    lastValue = sample;
+}
+
+BOOST_AUTO_TEST_CASE( realtime_mode_test )
+{
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(0.1) );
+    int slow = reader.addCursor( base::Time::fromSeconds(0.5) );
+
+    int s1 = reader.registerStream<double>( &value_callback, -1, base::Time::fromSeconds(0.01), -1, "s1" ); 
+    int s2 = reader.registerStream<double>( &value_callback, -1, base::Time::fromSeconds(0.02), -1, "s2" ); 
+    int s3 = reader.registerStream<double>( &value_callback, 0, base::Time::fromSeconds(0.01) ); 
+
+    // dynamically sized buffers are not allowed in real-time mode
+    BOOST_REQUIRE_THROW( reader.setRealtimeMode( true ), std::runtime_error );
+    reader.unregisterStream( s3 );
+    reader.setRealtimeMode( true );
+    BOOST_REQUIRE_THROW( reader.registerStream<double>( &value_callback, 10, base::Time() ), std::runtime_error );
+    BOOST_REQUIRE_THROW( reader.addCursor( base::Time() ), std::runtime_error );
+    BOOST_REQUIRE_THROW( reader.unregisterStream( s1 ), std::runtime_error );
+    BOOST_REQUIRE_THROW( reader.setDuplicateFilter( s1, 16 ), std::runtime_error );
+    reader.setCursorCallback<double>( slow, s1, &value_callback );
+
+    size_t allocations = allocationCount;
+    size_t processed = 0;
+    for( int i = 1; i < 1000; i++ )
+    {
+	reader.push( s1, base::Time::fromSeconds(i * 0.01), i * 1.0 ); 
+	if( i % 2 == 0 )
+	    reader.push( s2, base::Time::fromSeconds(i * 0.01), i * 1.0 ); 
+	while( reader.step() )
+	    processed++;
+	while( reader.step( slow ) );
+	reader.getBufferStatus( s1 );
+	reader.getStatus();
+    }
+    reader.clear();
+    BOOST_CHECK_EQUAL( allocationCount - allocations, 0 );
+    BOOST_CHECK( processed > 1000 );
+
+    reader.setRealtimeMode( false );
+    reader.unregisterStream( s1 );
+}
+
+class CountingMemoryResource : public MemoryResource
+{
+public:
+    CountingMemoryResource() : allocations( 0 ), bytes( 0 ) {}
+
+    size_t allocations;
+    size_t bytes;
+
+protected:
+    void* doAllocate( size_t size, size_t alignment )
+    {
+	allocations++;
+	bytes += size;
+	return getDefaultMemoryResource()->allocate( size, alignment );
+    }
+
+    void doDeallocate( void *ptr, size_t size, size_t alignment )
+    {
+	bytes -= size;
+	getDefaultMemoryResource()->deallocate( ptr, size, alignment );
+    }
+};
+
+BOOST_AUTO_TEST_CASE( memory_resource_test )
+{
+    CountingMemoryResource memory;
+    {
+	StreamAligner reader; 
+	reader.setTimeout( base::Time::fromSeconds(2.0) );
+
+	int s1 = reader.registerStream<string>( &test_callback, 4, base::Time::fromSeconds(2), -1, "s1", &memory ); 
+	// stream object, timestamp ring and sample ring
+	BOOST_CHECK_EQUAL( memory.allocations, 3 );
+	BOOST_CHECK( memory.bytes >= 4 * (sizeof(base::Time) + sizeof(string)) );
+
+	reader.setMemoryResource( &memory );
+	int s2 = reader.registerStream<string>( &test_callback, 0, base::Time::fromSeconds(2), 1 );
+	BOOST_CHECK_EQUAL( memory.allocations, 6 );
+
+	reader.push( s1, base::Time::fromSeconds(1.0), string("a") ); 
+	for( int i = 0; i < 30; i++ )
+	    reader.push( s2, base::Time::fromSeconds(2.0 + i), string("b") ); 
+	// the dynamically sized buffer grew in the resource
+	BOOST_CHECK( memory.allocations > 6 );
+
+	lastSample = ""; reader.step(); BOOST_CHECK_EQUAL( lastSample, "a" );
+	lastSample = ""; reader.step(); BOOST_CHECK_EQUAL( lastSample, "b" );
+
+	reader.unregisterStream( s2 );
+    }
+    BOOST_CHECK_EQUAL( memory.bytes, 0 );
+}
+
+#if __cplusplus >= 201703L
+BOOST_AUTO_TEST_CASE( pmr_memory_resource_test )
+{
+    char arena[4096];
+    std::pmr::monotonic_buffer_resource monotonic( arena, sizeof(arena), std::pmr::null_memory_resource() );
+    PmrMemoryResource memory( &monotonic );
+
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+    int s1 = reader.registerStream<double>( &value_callback, 10, base::Time::fromSeconds(1), -1, "s1", &memory ); 
+
+    reader.push( s1, base::Time::fromSeconds(1.0), 1.0 ); 
+    reader.push( s1, base::Time::fromSeconds(2.0), 2.0 ); 
+    reader.push( s1, base::Time::fromSeconds(3.0), 3.0 ); 
+    lastValue = 0; reader.step(); BOOST_CHECK_EQUAL( lastValue, 1.0 );
+}
+#endif
+
+void packet_callback( const base::Time &time, const ByteSpan& packet )
+{
+    lastSample = string( reinterpret_cast<const char*>( packet.data() ), packet.size() );
+}
+
+BOOST_AUTO_TEST_CASE( packet_stream_test )
+{
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+
+    // 16 bytes of header per packet, payloads padded to 8 bytes
+    int s1 = reader.registerPacketStream( &packet_callback, 80, base::Time::fromSeconds(2) ); 
+    int s2 = reader.registerStream<string>( &test_callback, 4, base::Time::fromSeconds(2), 1 );
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).buffer_size, 80 );
+
+    reader.pushPacket( s1, base::Time::fromSeconds(1.0), string("a") ); 
+    reader.pushPacket( s1, base::Time::fromSeconds(3.0), string("ccccccccc") ); 
+    reader.push( s2, base::Time::fromSeconds(2.0), string("b") ); 
+    reader.push( s2, base::Time::fromSeconds(3.0), string("d") ); 
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).buffer_fill, 24 + 32 );
+
+    lastSample = ""; reader.step(); BOOST_CHECK_EQUAL( lastSample, "a" );
+    lastSample = ""; reader.step(); BOOST_CHECK_EQUAL( lastSample, "b" );
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).buffer_fill, 32 );
+
+    // this packet does not fit at the end of the ring anymore, and needs
+    // the space of the c packet
+    std::vector<uint8_t> e( 20, 'e' );
+    reader.pushPacket( s1, base::Time::fromSeconds(4.0), e ); 
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).samples_dropped_buffer_full, 1 );
+    reader.push( s2, base::Time::fromSeconds(4.0), string("f") ); 
+
+    lastSample = ""; reader.step(); BOOST_CHECK_EQUAL( lastSample, "d" );
+    lastSample = ""; reader.step(); BOOST_CHECK_EQUAL( lastSample, string( 20, 'e' ) );
+    lastSample = ""; reader.step(); BOOST_CHECK_EQUAL( lastSample, "f" );
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).buffer_fill, 0 );
+
+    // packets larger than the ring are dropped
+    reader.pushPacket( s1, base::Time::fromSeconds(5.0), string( 100, 'x' ) ); 
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).samples_dropped_buffer_full, 2 );
+    BOOST_CHECK( !reader.step() );
+}
+
+BOOST_AUTO_TEST_CASE( buffer_auto_size_test )
+{
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+
+    // the declared period is ten times too large
+    int s1 = reader.registerStream<double>( &value_callback, -1, base::Time::fromSeconds(1.0) ); 
+    reader.registerStream<double>( &value_callback, 5, base::Time::fromSeconds(1.0) ); 
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).buffer_size, 4 );
+
+    for( int i = 1; i <= 19; i++ )
+	reader.push( s1, base::Time::fromSeconds(i * 0.1), i * 1.0 ); 
+
+    // the buffer followed the measured period without dropping samples
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).buffer_size, 40 );
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).samples_dropped_buffer_full, 0 );
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).buffer_fill, 19 );
+
+    // the buffer follows timeout changes
+    reader.setTimeout( base::Time::fromSeconds(10.0) );
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).buffer_size, 200 );
+    reader.setBufferSizeFactor( 1.5 );
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).buffer_size, 200 );
+    reader.setTimeout( base::Time::fromSeconds(1.0) );
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).buffer_size, 19 );
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).buffer_fill, 19 );
+
+    lastValue = 0; reader.step(); BOOST_CHECK_EQUAL( lastValue, 1.0 );
+}
+
+struct CountedSample
+{
+    static int copies;
+    std::vector<int> data;
+
+    CountedSample() {}
+    explicit CountedSample( int size ) : data( size ) {}
+    CountedSample( const CountedSample &other ) : data( other.data ) { copies++; }
+    CountedSample& operator=( const CountedSample &other ) { data = other.data; copies++; return *this; }
+};
+int CountedSample::copies = 0;
+
+vector<int> takenSizes;
+
+void take_callback( const base::Time &time, CountedSample& sample )
+{
+    std::vector<int> taken;
+    taken.swap( sample.data );
+    takenSizes.push_back( taken.size() );
+}
+
+BOOST_AUTO_TEST_CASE( move_callback_test )
+{
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+
+    int s1 = reader.registerMoveStream<CountedSample>( &take_callback, 4, base::Time::fromSeconds(1) ); 
+    reader.push( s1, base::Time::fromSeconds(1.0), CountedSample(1000) ); 
+    reader.push( s1, base::Time::fromSeconds(2.0), CountedSample(1000) ); 
+
+    takenSizes.clear();
+    CountedSample::copies = 0;
+    while( reader.step() );
+    BOOST_CHECK_EQUAL( CountedSample::copies, 0 );
+    BOOST_REQUIRE_EQUAL( takenSizes.size(), 2 );
+    BOOST_CHECK_EQUAL( takenSizes[1], 1000 );
+
+    // with two cursors, only the last one gets the buffered sample
+    int second = reader.addCursor( base::Time::fromSeconds(2.0) );
+    reader.setCursorMoveCallback<CountedSample>( second, s1, &take_callback );
+    reader.push( s1, base::Time::fromSeconds(3.0), CountedSample(1000) ); 
+
+    takenSizes.clear();
+    CountedSample::copies = 0;
+    BOOST_CHECK( reader.step( second ) );
+    BOOST_CHECK_EQUAL( CountedSample::copies, 1 );
+    BOOST_CHECK( reader.step() );
+    BOOST_CHECK_EQUAL( CountedSample::copies, 1 );
+    BOOST_REQUIRE_EQUAL( takenSizes.size(), 2 );
+    BOOST_CHECK_EQUAL( takenSizes[0], 1000 );
+    BOOST_CHECK_EQUAL( takenSizes[1], 1000 );
+}
+
+struct TimedSample
+{
+    base::Time time;
+    int value;
+    int refs;
+
+    TimedSample( const base::Time &time, int value ) : time( time ), value( value ), refs( 0 ) {}
+};
+
+void intrusive_ptr_add_ref( TimedSample *sample ) { sample->refs++; }
+void intrusive_ptr_release( TimedSample *sample ) { if( --sample->refs == 0 ) delete sample; }
+
+vector<int> timedValues;
+
+void timed_callback( const base::Time &time, const TimedSample &sample )
+{
+    BOOST_CHECK( time == sample.time );
+    timedValues.push_back( sample.value );
+}
+
+void timed_handle_callback( const base::Time &time, const boost::intrusive_ptr<TimedSample> &sample )
+{
+    BOOST_CHECK( time == sample->time );
+    timedValues.push_back( sample->value );
+}
+
+#if __cplusplus >= 201103L
+void timed_unique_callback( const base::Time &time, const std::unique_ptr<TimedSample> &sample )
+{
+    BOOST_CHECK( time == sample->time );
+    timedValues.push_back( sample->value );
+}
+#endif
+
+BOOST_AUTO_TEST_CASE( timestamp_deducing_push_test )
+{
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+
+    int s1 = reader.registerStream<TimedSample>( &timed_callback, 4, base::Time::fromSeconds(1) ); 
+    int s2 = reader.registerStream<boost::intrusive_ptr<TimedSample> >( &timed_handle_callback, 4, base::Time::fromSeconds(1) ); 
+
+    reader.push( s1, TimedSample( base::Time::fromSeconds(1.0), 1 ) );
+    boost::intrusive_ptr<TimedSample> handle( new TimedSample( base::Time::fromSeconds(2.0), 2 ) );
+    reader.push( s2, handle );
+    // the stream only holds a reference
+    BOOST_CHECK_EQUAL( handle->refs, 2 );
+
+    timedValues.clear();
+    while( reader.step() );
+    BOOST_REQUIRE_EQUAL( timedValues.size(), 2 );
+    BOOST_CHECK_EQUAL( timedValues[0], 1 );
+    BOOST_CHECK_EQUAL( timedValues[1], 2 );
+    BOOST_CHECK_EQUAL( handle->refs, 1 );
+
+    BOOST_CHECK_THROW( reader.push( s2, boost::intrusive_ptr<TimedSample>() ), std::invalid_argument );
+}
+
+#if __cplusplus >= 201103L
+BOOST_AUTO_TEST_CASE( unique_ptr_push_test )
+{
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+
+    int s1 = reader.registerStream<std::unique_ptr<TimedSample> >( &timed_unique_callback, 4, base::Time::fromSeconds(1) ); 
+    for(int i=1;i<=3;i++)
+    {
+	std::unique_ptr<TimedSample> sample( new TimedSample( base::Time::fromSeconds(i), i ) );
+	reader.push( s1, std::move( sample ) );
+	BOOST_CHECK( !sample );
+    }
+
+    // the samples can not be copied into a second aligner
+    StreamAligner copy;
+    copy.registerStream<std::unique_ptr<TimedSample> >( &timed_unique_callback, 4, base::Time::fromSeconds(1) ); 
+    BOOST_CHECK_THROW( copy.copyState( reader ), std::runtime_error );
+
+    timedValues.clear();
+    while( reader.step() );
+    BOOST_REQUIRE_EQUAL( timedValues.size(), 3 );
+    BOOST_CHECK_EQUAL( timedValues[2], 3 );
+}
+#endif
+
+vector<size_t> transformedSamples;
+
+void transformed_callback( const base::Time &time, const size_t &length )
+{
+    transformedSamples.push_back( length );
+}
+
+/** keeps the length of every second non-empty string */
+struct LengthStage
+{
+    int count;
+    LengthStage() : count( 0 ) {}
+
+    bool operator()( const base::Time &time, const string &input, size_t &output )
+    {
+	if( input.empty() || count++ % 2 )
+	    return false;
+	output = input.size();
+	return true;
+    }
+};
+
+BOOST_AUTO_TEST_CASE( transform_stream_test )
+{
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+
+    int s1 = reader.registerTransformStream<string, size_t>( LengthStage(), &transformed_callback, 4, base::Time::fromSeconds(1) ); 
+    reader.push( s1, base::Time::fromSeconds(1.0), string("a") ); 
+    reader.push( s1, base::Time::fromSeconds(2.0), string("bb") ); 
+    reader.push( s1, base::Time::fromSeconds(3.0), string("") ); 
+    reader.push( s1, base::Time::fromSeconds(4.0), string("cccc") ); 
+
+    const StreamStatus &status( reader.getBufferStatus( s1 ) );
+    BOOST_CHECK_EQUAL( status.samples_received, 4 );
+    BOOST_CHECK_EQUAL( status.samples_filtered, 2 );
+    BOOST_CHECK_EQUAL( status.buffer_fill, 2 );
+
+    std::pair<base::Time, size_t> next;
+    BOOST_CHECK( reader.getNextSample( s1, next ) );
+    BOOST_CHECK_EQUAL( next.second, 1 );
+
+    transformedSamples.clear();
+    while( reader.step() );
+    BOOST_REQUIRE_EQUAL( transformedSamples.size(), 2 );
+    BOOST_CHECK_EQUAL( transformedSamples[0], 1 );
+    BOOST_CHECK_EQUAL( transformedSamples[1], 4 );
+}
+
+vector<double> reductionEvents;
+
+void reduction_callback( const base::Time &time, const ReductionSummary<double> &summary )
+{
+    reductionEvents.push_back( time.toSeconds() );
+    reductionEvents.push_back( summary.min );
+    reductionEvents.push_back( summary.max );
+    reductionEvents.push_back( summary.mean() );
+    reductionEvents.push_back( summary.last );
+}
+
+void reduction_sample_callback( const base::Time &time, const string &sample )
+{
+    reductionEvents.push_back( -time.toSeconds() );
+}
+
+BOOST_AUTO_TEST_CASE( reduction_stream_test )
+{
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+
+    int s1 = reader.registerReductionStream<double, ReductionSummary<double> >( &ReductionSummary<double>::fold, ReductionSummary<double>(),
+	    base::Time::fromSeconds(1.0), &reduction_callback, 2 ); 
+    int s2 = reader.registerStream<string>( &reduction_sample_callback, 4, base::Time::fromSeconds(1.0) ); 
+    BOOST_CHECK_THROW( (reader.registerReductionStream<double, ReductionSummary<double> >( &ReductionSummary<double>::fold,
+		    ReductionSummary<double>(), base::Time(), &reduction_callback, 2 )), std::runtime_error );
+
+    // the first bucket is [1,2), the second [2,3), and [3,4) is skipped
+    reader.push( s1, base::Time::fromSeconds(1.1), 4.0 ); 
+    reader.push( s1, base::Time::fromSeconds(1.5), 2.0 ); 
+    reader.push( s1, base::Time::fromSeconds(1.9), 3.0 ); 
+    reader.push( s2, base::Time::fromSeconds(1.5), string("a") ); 
+    reader.push( s1, base::Time::fromSeconds(2.2), 5.0 ); 
+    reader.push( s2, base::Time::fromSeconds(2.5), string("b") ); 
+    // back into a closed bucket
+    reader.push( s1, base::Time::fromSeconds(1.95), 1.0 ); 
+    reader.push( s1, base::Time::fromSeconds(4.5), 7.0 ); 
+
+    const StreamStatus &status( reader.getBufferStatus( s1 ) );
+    BOOST_CHECK_EQUAL( status.samples_received, 6 );
+    BOOST_CHECK_EQUAL( status.samples_backward_in_time, 1 );
+    BOOST_CHECK_EQUAL( status.buffer_fill, 2 );
+
+    // the buckets are given out at their end time
+    reductionEvents.clear();
+    while( reader.step() );
+    BOOST_REQUIRE_EQUAL( reductionEvents.size(), 12 );
+    BOOST_CHECK_CLOSE( reductionEvents[0], -1.5, 1e-6 );
+    BOOST_CHECK_CLOSE( reductionEvents[1], 2.0, 1e-6 );
+    BOOST_CHECK_CLOSE( reductionEvents[2], 2.0, 1e-6 );
+    BOOST_CHECK_CLOSE( reductionEvents[3], 4.0, 1e-6 );
+    BOOST_CHECK_CLOSE( reductionEvents[4], 3.0, 1e-6 );
+    BOOST_CHECK_CLOSE( reductionEvents[5], 3.0, 1e-6 );
+    BOOST_CHECK_CLOSE( reductionEvents[6], -2.5, 1e-6 );
+    BOOST_CHECK_CLOSE( reductionEvents[7], 3.0, 1e-6 );
+    BOOST_CHECK_CLOSE( reductionEvents[8], 5.0, 1e-6 );
+    BOOST_CHECK_CLOSE( reductionEvents[11], 5.0, 1e-6 );
+
+    // the last bucket is only given out once flushed
+    reductionEvents.clear();
+    reader.flushStream( s1 );
+    reader.flushStream( s2 );
+    reader.push( s2, base::Time::fromSeconds(5.5), string("c") ); 
+    while( reader.step() );
+    BOOST_REQUIRE_EQUAL( reductionEvents.size(), 6 );
+    BOOST_CHECK_CLOSE( reductionEvents[0], 5.0, 1e-6 );
+    BOOST_CHECK_CLOSE( reductionEvents[4], 7.0, 1e-6 );
+    BOOST_CHECK_CLOSE( reductionEvents[5], -5.5, 1e-6 );
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).samples_processed, 3 );
+}
+
+BOOST_AUTO_TEST_CASE( compressed_sample_buffer_test )
+{
+    // random words and time steps, which exercise all code lengths
+    for( int coding = 0; coding < 2; ++coding )
+    {
+	CompressedSampleBuffer buffer( 1 << 16, 3, coding ? CompressedSampleBuffer::DELTA_CODING : CompressedSampleBuffer::XOR_CODING );
+	BOOST_CHECK_THROW( CompressedSampleBuffer( buffer.blockSize(), 3, CompressedSampleBuffer::XOR_CODING ), std::runtime_error );
+
+	srand( 42 );
+	vector<int64_t> times;
+	vector<uint64_t> values;
+	int64_t us = -1000;
+	for( int i = 0; i < 300; ++i )
+	{
+	    int shift = rand() % 40;
+	    us += (rand() % 3) ? 1000 : (int64_t(rand()) << shift) % (int64_t(1) << 40);
+	    times.push_back( us );
+	    for( int c = 0; c < 3; ++c )
+	    {
+		uint64_t v = (uint64_t(rand()) << 33) ^ (uint64_t(rand()) << (rand() % 32));
+		values.push_back( rand() % 4 ? (values.size() >= 3 ? values[values.size() - 3] : 0) : v );
+	    }
+	    BOOST_REQUIRE_EQUAL( buffer.push( base::Time::fromMicroseconds( us ), &values[values.size() - 3] ), 0 );
+	}
+	BOOST_CHECK_EQUAL( buffer.count(), 300 );
+
+	CompressedSampleBuffer::Reader reader;
+	buffer.begin( reader );
+	uint64_t decoded[3];
+	for( int i = 0; i < 300; ++i )
+	{
+	    BOOST_REQUIRE( !buffer.atEnd( reader ) );
+	    BOOST_REQUIRE( buffer.peekTime( reader ) == base::Time::fromMicroseconds( times[i] ) );
+	    BOOST_REQUIRE( buffer.read( reader, decoded ) == base::Time::fromMicroseconds( times[i] ) );
+	    for( int c = 0; c < 3; ++c )
+		BOOST_REQUIRE_EQUAL( decoded[c], values[3 * i + c] );
+	}
+	BOOST_CHECK( buffer.atEnd( reader ) );
+	BOOST_CHECK_EQUAL( buffer.release( buffer.neededBlock( reader ) ) + buffer.count(), 300 );
+    }
+}
+
+vector<double> compressedSamples;
+
+void compressed_callback( const base::Time &time, const double &value )
+{
+    compressedSamples.push_back( time.toSeconds() );
+    compressedSamples.push_back( value );
+}
+
+void compressed_array_callback( const base::Time &time, const boost::array<float,3> &value )
+{
+    compressedSamples.push_back( -time.toSeconds() );
+    compressedSamples.push_back( value[0] + value[1] + value[2] );
+}
+
+BOOST_AUTO_TEST_CASE( compressed_stream_test )
+{
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+
+    int s1 = reader.registerCompressedStream<double>( &compressed_callback, 4096, base::Time::fromMilliseconds(10) ); 
+    int s2 = reader.registerCompressedStream<boost::array<float,3> >( &compressed_array_callback, 4096, base::Time::fromMilliseconds(25) ); 
+
+    // regularly sampled, slowly changing values are coded in a few bits
+    for( int i = 0; i < 200; ++i )
+    {
+	reader.push( s1, base::Time::fromMilliseconds(1000 + 10 * i), 20.0 + 0.5 * (i / 10) ); 
+	if( i % 5 == 0 )
+	{
+	    boost::array<float,3> value = {{ float(i), 0.25f, -1.0f }};
+	    reader.push( s2, base::Time::fromMilliseconds(1001 + 10 * i), value ); 
+	}
+    }
+    reader.push( s1, base::Time::fromMilliseconds(500), 1.0 ); 
+
+    const StreamStatus &status( reader.getBufferStatus( s1 ) );
+    BOOST_CHECK_EQUAL( status.samples_received, 201 );
+    BOOST_CHECK_EQUAL( status.samples_backward_in_time, 1 );
+    BOOST_CHECK( status.buffer_fill < 200 * 16 / 5 );
+    BOOST_CHECK( status.earliest_data_time == base::Time::fromMilliseconds(1000) );
+
+    // s2 has no more samples, do not wait for it
+    reader.disableStream( s2 );
+    compressedSamples.clear();
+    while( reader.step() );
+    BOOST_REQUIRE_EQUAL( compressedSamples.size(), 2 * 240 );
+    for( int i = 0, pos = 0; i < 200; ++i )
+    {
+	BOOST_CHECK_CLOSE( compressedSamples[pos++], 1.0 + 0.01 * i, 1e-6 );
+	BOOST_CHECK_EQUAL( compressedSamples[pos++], 20.0 + 0.5 * (i / 10) );
+	if( i % 5 == 0 )
+	{
+	    BOOST_CHECK_CLOSE( compressedSamples[pos++], -1.001 - 0.01 * i, 1e-6 );
+	    BOOST_CHECK_EQUAL( compressedSamples[pos++], i - 0.75 );
+	}
+    }
+
+    // the oldest blocks are dropped when the buffer is full
+    reader.clear();
+    for( int i = 0; i < 5000; ++i )
+	reader.push( s1, base::Time::fromMilliseconds(1000 + 10 * i), double( i ) ); 
+    BOOST_CHECK( reader.getBufferStatus( s1 ).samples_dropped_buffer_full > 0 );
+
+    compressedSamples.clear();
+    while( reader.step() );
+    BOOST_REQUIRE( !compressedSamples.empty() );
+    BOOST_CHECK_EQUAL( compressedSamples.back(), 4999 );
+    BOOST_CHECK_EQUAL( compressedSamples.size() / 2 + reader.getBufferStatus( s1 ).samples_dropped_buffer_full, 5000 );
+    for( size_t i = 3; i < compressedSamples.size(); i += 2 )
+	BOOST_REQUIRE_EQUAL( compressedSamples[i], compressedSamples[i - 2] + 1 );
+
+    // the samples of a dropped block that were already given to the
+    // callback are not counted as dropped
+    reader.clear();
+    compressedSamples.clear();
+    for( int i = 0; i < 10; ++i )
+	reader.push( s1, base::Time::fromMilliseconds(1000 + 10 * i), double( i ) ); 
+    for( int i = 0; i < 5; ++i )
+	reader.step();
+    for( int i = 10; i < 5000; ++i )
+	reader.push( s1, base::Time::fromMilliseconds(1000 + 10 * i), double( i ) ); 
+    while( reader.step() );
+    const StreamStatus &full( reader.getBufferStatus( s1 ) );
+    BOOST_CHECK( full.samples_dropped_buffer_full > 0 );
+    BOOST_CHECK_EQUAL( full.samples_processed, compressedSamples.size() / 2 );
+    BOOST_CHECK_EQUAL( full.samples_processed + full.samples_dropped_buffer_full, 5000 );
+
+    // with two cursors, a sample is processed once both read it
+    StreamAligner cursors;
+    cursors.setTimeout( base::Time::fromSeconds(2.0) );
+    int slow = cursors.addCursor( base::Time::fromSeconds(2.0) );
+    int s3 = cursors.registerCompressedStream<double>( &compressed_callback, 4096, base::Time::fromMilliseconds(10) ); 
+    for( int i = 0; i < 10; ++i )
+	cursors.push( s3, base::Time::fromMilliseconds(1000 + 10 * i), double( i ) ); 
+    while( cursors.step() );
+    BOOST_CHECK_EQUAL( cursors.getBufferStatus( s3 ).samples_processed, 0 );
+    for( int i = 0; i < 4; ++i )
+	cursors.step( slow );
+    BOOST_CHECK_EQUAL( cursors.getBufferStatus( s3 ).samples_processed, 4 );
+}
+
+BOOST_AUTO_TEST_CASE( recent_keys_test )
+{
+    // compare with a plain list of the last keys, with many collisions
+    RecentKeys keys( 16 );
+    std::deque<uint64_t> reference;
+    srand( 7 );
+    for( int i = 0; i < 10000; ++i )
+    {
+	uint64_t key = rand() % 64;
+	bool known = std::find( reference.begin(), reference.end(), key ) != reference.end();
+	BOOST_REQUIRE_EQUAL( keys.contains( key ), known );
+	BOOST_REQUIRE_EQUAL( keys.insert( key ), !known );
+	if( !known )
+	{
+	    reference.push_back( key );
+	    if( reference.size() > 16 )
+		reference.pop_front();
+	}
+	BOOST_REQUIRE_EQUAL( keys.size(), reference.size() );
+    }
+
+    RecentKeys disabled;
+    BOOST_CHECK( disabled.insert( 1 ) );
+    BOOST_CHECK( disabled.insert( 1 ) );
+}
+
+struct sequenced_sample
+{
+    uint64_t seq;
+    int value;
+};
+
+vector<int> duplicateSamples;
+
+void duplicate_callback( const base::Time &time, const sequenced_sample &sample )
+{
+    duplicateSamples.push_back( sample.value );
+}
+
+void duplicate_time_callback( const base::Time &time, const int &value )
+{
+    duplicateSamples.push_back( value );
+}
+
+uint64_t sample_sequence( const sequenced_sample &sample )
+{
+    return sample.seq;
+}
+
+BOOST_AUTO_TEST_CASE( duplicate_filter_test )
+{
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+
+    int s1 = reader.registerStream<int>( &duplicate_time_callback, 10, base::Time::fromSeconds(1) ); 
+    reader.setDuplicateFilter( s1, 4 );
+
+    // the second link is one sample late
+    reader.push( s1, base::Time::fromSeconds(1.0), 1 ); 
+    reader.push( s1, base::Time::fromSeconds(2.0), 2 ); 
+    reader.push( s1, base::Time::fromSeconds(1.0), 1 ); 
+    reader.push( s1, base::Time::fromSeconds(3.0), 3 ); 
+    reader.push( s1, base::Time::fromSeconds(2.0), 2 ); 
+    reader.push( s1, base::Time::fromSeconds(3.0), 3 ); 
+
+    const StreamStatus &status( reader.getBufferStatus( s1 ) );
+    BOOST_CHECK_EQUAL( status.samples_received, 6 );
+    BOOST_CHECK_EQUAL( status.samples_duplicate, 3 );
+    BOOST_CHECK_EQUAL( status.samples_backward_in_time, 0 );
+    BOOST_CHECK_EQUAL( status.buffer_fill, 3 );
+
+    duplicateSamples.clear();
+    reader.disableStream( s1 );
+    while( reader.step() );
+    BOOST_REQUIRE_EQUAL( duplicateSamples.size(), 3 );
+    BOOST_CHECK_EQUAL( duplicateSamples[2], 3 );
+
+    // older samples than the window are not recognized anymore
+    reader.clear();
+    reader.setDuplicateFilter( s1, 2 );
+    reader.push( s1, base::Time::fromSeconds(1.0), 1 ); 
+    reader.push( s1, base::Time::fromSeconds(2.0), 2 ); 
+    reader.push( s1, base::Time::fromSeconds(3.0), 3 ); 
+    reader.push( s1, base::Time::fromSeconds(1.0), 1 ); 
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).samples_duplicate, 0 );
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).samples_backward_in_time, 1 );
+
+    // samples with equal timestamps are kept, based on their sequence
+    // number
+    int s2 = reader.registerStream<sequenced_sample>( &duplicate_callback, 10, base::Time::fromSeconds(1) ); 
+    reader.setDuplicateFilter<sequenced_sample>( s2, &sample_sequence, 8 );
+    BOOST_CHECK_THROW( reader.push( s2, base::Time::fromSeconds(5.0), 5 ), std::runtime_error );
+    sequenced_sample a = { 10, 10 }, b = { 11, 11 };
+    reader.push( s2, base::Time::fromSeconds(5.0), a ); 
+    reader.push( s2, base::Time::fromSeconds(5.0), b ); 
+    reader.push( s2, base::Time::fromSeconds(5.0), a ); 
+    reader.push( s2, base::Time::fromSeconds(5.0), b ); 
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s2 ).samples_duplicate, 2 );
+
+    duplicateSamples.clear();
+    reader.disableStream( s1 );
+    reader.disableStream( s2 );
+    while( reader.step() );
+    BOOST_REQUIRE_EQUAL( duplicateSamples.size(), 5 );
+    BOOST_CHECK_EQUAL( duplicateSamples[3], 10 );
+    BOOST_CHECK_EQUAL( duplicateSamples[4], 11 );
+}
+
+bool is_readable( int fd )
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    return poll( &pfd, 1, 0 ) == 1 && (pfd.revents & POLLIN);
+}
+
+BOOST_AUTO_TEST_CASE( readiness_notification_test )
+{
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+
+    int s1 = reader.registerStream<string>( &test_callback, 4, base::Time::fromSeconds(2) ); 
+    int s2 = reader.registerStream<string>( &test_callback, 4, base::Time::fromSeconds(2) ); 
+    int fd = reader.enableReadinessNotification();
+    BOOST_CHECK( !reader.canStep() );
+    BOOST_CHECK( !is_readable( fd ) );
+
+    // s2 may still deliver an earlier sample
+    reader.push( s1, base::Time::fromSeconds(10), string("a") ); 
+    BOOST_CHECK( !reader.canStep() );
+    BOOST_CHECK( !is_readable( fd ) );
+
+    reader.push( s2, base::Time::fromSeconds(11), string("b") ); 
+    BOOST_CHECK( reader.canStep() );
+    BOOST_CHECK( is_readable( fd ) );
+    // checking does not consume the notification
+    BOOST_CHECK( is_readable( fd ) );
+
+    BOOST_CHECK( reader.step() );
+    BOOST_CHECK( is_readable( fd ) );
+    BOOST_CHECK( reader.step() );
+    BOOST_CHECK( !reader.canStep() );
+    BOOST_CHECK( !is_readable( fd ) );
+
+    // s1 may still deliver a sample at 12
+    reader.push( s2, base::Time::fromSeconds(12.5), string("c") ); 
+    BOOST_CHECK( !is_readable( fd ) );
+    // unless it is disabled
+    reader.disableStream( s1 );
+    BOOST_CHECK( is_readable( fd ) );
+    BOOST_CHECK( reader.step() );
+    BOOST_CHECK( !is_readable( fd ) );
+
+    // or once it timed out
+    reader.enableStream( s1 );
+    reader.push( s2, base::Time::fromSeconds(15), string("d") ); 
+    BOOST_CHECK( is_readable( fd ) );
+    while( reader.step() );
+    BOOST_CHECK( !is_readable( fd ) );
+
+    reader.push( s2, base::Time::fromSeconds(20), string("e") ); 
+    BOOST_CHECK( is_readable( fd ) );
+    reader.clear();
+    BOOST_CHECK( !is_readable( fd ) );
+    reader.disableReadinessNotification();
+}
+
+vector<double> tickEvents;
+
+void tick_callback( const base::Time &time )
+{
+    tickEvents.push_back( -time.toSeconds() );
+}
+
+void tick_sample_callback( const base::Time &time, const string &sample )
+{
+    tickEvents.push_back( time.toSeconds() );
+}
+
+BOOST_AUTO_TEST_CASE( tick_stream_test )
+{
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+
+    int s1 = reader.registerStream<string>( &tick_sample_callback, 4, base::Time::fromSeconds(0.5) ); 
+    int t1 = reader.registerTickStream( &tick_callback, base::Time::fromSeconds(0.5), 1 ); 
+    BOOST_CHECK( !reader.isStreamActive( t1 ) );
+    BOOST_CHECK_THROW( reader.registerTickStream( &tick_callback, base::Time() ), std::runtime_error );
+
+    // no ticks before the first sample
+    BOOST_CHECK( !reader.step() );
+
+    reader.push( s1, base::Time::fromSeconds(1.2), string("a") ); 
+    reader.push( s1, base::Time::fromSeconds(1.7), string("b") ); 
+    reader.push( s1, base::Time::fromSeconds(2.3), string("c") ); 
+
+    tickEvents.clear();
+    while( reader.step() );
+    // ticks are given as negative times
+    BOOST_REQUIRE_EQUAL( tickEvents.size(), 5 );
+    BOOST_CHECK_CLOSE( tickEvents[0], 1.2, 1e-6 );
+    BOOST_CHECK_CLOSE( tickEvents[1], -1.5, 1e-6 );
+    BOOST_CHECK_CLOSE( tickEvents[2], 1.7, 1e-6 );
+    BOOST_CHECK_CLOSE( tickEvents[3], -2.0, 1e-6 );
+    BOOST_CHECK_CLOSE( tickEvents[4], 2.3, 1e-6 );
+
+    // the next tick waits for a sample at or after it
+    reader.push( s1, base::Time::fromSeconds(2.5), string("d") ); 
+    tickEvents.clear();
+    while( reader.step() );
+    BOOST_REQUIRE_EQUAL( tickEvents.size(), 2 );
+    BOOST_CHECK_CLOSE( tickEvents[0], 2.5, 1e-6 );
+    BOOST_CHECK_CLOSE( tickEvents[1], -2.5, 1e-6 );
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( t1 ).samples_processed, 3 );
+}
+
+BOOST_AUTO_TEST_CASE( rate_status_test )
+{
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+
+    int s1 = reader.registerStream<string>( &test_callback, 100, base::Time::fromSeconds(0.1) ); 
+    int s2 = reader.registerStream<string>( &test_callback, 4, base::Time::fromSeconds(0.05) ); 
+
+    // s1 at 10Hz, s2 at 20Hz with a buffer that is too small, so that it
+    // drops samples
+    for( int i = 0; i < 100; i++ )
+    {
+	reader.push( s2, base::Time::fromSeconds(0.05 * i), string("b") ); 
+	if( i % 2 == 0 )
+	    reader.push( s1, base::Time::fromSeconds(0.05 * i), string("a") ); 
+    }
+    reader.disableStream( s2 );
+    while( reader.step() );
+
+    StreamStatus status( reader.getBufferStatus( s1 ) );
+    BOOST_CHECK_CLOSE( status.input_rate, 10.0, 1.0 );
+    BOOST_CHECK_SMALL( status.jitter, 1e-6 );
+    BOOST_CHECK_CLOSE( status.processed_rate, 10.0, 1.0 );
+    BOOST_CHECK_EQUAL( status.drop_rate, 0 );
+    BOOST_CHECK_EQUAL( status.samples_received, 50 );
+
+    status = reader.getBufferStatus( s2 );
+    BOOST_CHECK_CLOSE( status.input_rate, 20.0, 1.0 );
+    BOOST_CHECK( status.drop_rate > 0 );
+
+    // s2 stops receiving, its rate decreases with the data time
+    for( int i = 100; i < 140; i++ )
+	reader.push( s1, base::Time::fromSeconds(0.05 * i), string("a") ); 
+    BOOST_CHECK( reader.getBufferStatus( s2 ).input_rate < 1.0 );
+
+    // clear resets all counters and rates
+    reader.clear();
+    status = reader.getBufferStatus( s1 );
+    BOOST_CHECK_EQUAL( status.samples_received, 0 );
+    BOOST_CHECK_EQUAL( status.samples_processed, 0 );
+    BOOST_CHECK_EQUAL( status.input_rate, 0 );
+    BOOST_CHECK_EQUAL( status.processed_rate, 0 );
+}
+
+base::Time arrivalTime;
+
+base::Time arrival_clock()
+{
+    return arrivalTime;
+}
+
+BOOST_AUTO_TEST_CASE( lateness_tracking_test )
+{
+    LatencyHistogram histogram;
+    BOOST_CHECK( histogram.getPercentile( 0.5 ).isNull() );
+    for( int i = 1; i <= 100; i++ )
+	histogram.add( base::Time::fromMilliseconds( i ) );
+    // within the resolution of the buckets
+    BOOST_CHECK_CLOSE( histogram.getPercentile( 0.5 ).toSeconds(), 0.050, 20 );
+    BOOST_CHECK_CLOSE( histogram.getPercentile( 0.99 ).toSeconds(), 0.099, 20 );
+    BOOST_CHECK_EQUAL( histogram.getPercentile( 1.0 ).toMicroseconds(), 100000 );
+    BOOST_CHECK_EQUAL( histogram.getCount(), 100 );
+
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+    int s1 = reader.registerStream<string>( &test_callback, 100, base::Time::fromSeconds(0.1) ); 
+
+    // lateness is only recorded when enabled
+    reader.push( s1, base::Time::fromSeconds(1.0), string("a") ); 
+    BOOST_CHECK( reader.getBufferStatus( s1 ).lateness_max.isNull() );
+
+    // the clock runs 100 seconds behind the data time, and the samples
+    // arrive 10ms late, except for one every ten that is 200ms late
+    reader.enableLatenessTracking( &arrival_clock, base::Time::fromSeconds(100) );
+    for( int i = 0; i < 50; i++ )
+    {
+	base::Time ts = base::Time::fromSeconds(2.0 + 0.1 * i);
+	arrivalTime = ts - base::Time::fromSeconds(100) + base::Time::fromMilliseconds( i % 10 ? 10 : 200 );
+	reader.push( s1, ts, string("a") ); 
+    }
+
+    const StreamStatus &status( reader.getBufferStatus( s1 ) );
+    BOOST_CHECK_CLOSE( status.lateness_median.toSeconds(), 0.010, 20 );
+    BOOST_CHECK_CLOSE( status.lateness_p99.toSeconds(), 0.200, 20 );
+    BOOST_CHECK_EQUAL( status.lateness_max.toMicroseconds(), 200000 );
+
+    reader.clear();
+    BOOST_CHECK( reader.getBufferStatus( s1 ).lateness_max.isNull() );
+}
+
+vector<StreamAligner::LatencyViolation> latencyAlarms;
+
+void latency_alarm( const StreamAligner::LatencyViolation &violation )
+{
+    latencyAlarms.push_back( violation );
+}
+
+BOOST_AUTO_TEST_CASE( latency_budget_test )
+{
+    StreamAligner reader; 
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+    reader.enableLatenessTracking( &arrival_clock );
+    reader.setLatencyAlarm( &latency_alarm, base::Time::fromSeconds(1.0) );
+
+    int s1 = reader.registerStream<string>( &test_callback, 100, base::Time::fromSeconds(0.1) ); 
+    int s2 = reader.registerStream<string>( &test_callback, 100, base::Time::fromSeconds(0.1), 1 ); 
+    int p1 = reader.registerPacketStream( &packet_callback, 1024, base::Time::fromSeconds(0.1) ); 
+    reader.setLatencyBudget( s1, base::Time::fromSeconds(0.5) );
+    reader.setLatencyBudget( s2, base::Time(), base::Time::fromSeconds(0.25) );
+    BOOST_CHECK_THROW( reader.setLatencyBudget( p1, base::Time(), base::Time::fromSeconds(0.25) ), std::runtime_error );
+
+    // all samples arrive at once, and are processed 0.3 seconds later
+    arrivalTime = base::Time::fromSeconds(10);
+    for( int i = 1; i <= 20; i++ )
+    {
+	reader.push( s1, base::Time::fromSeconds(0.1 * i), string("a") ); 
+	reader.push( s2, base::Time::fromSeconds(0.1 * i), string("b") ); 
+    }
+    reader.disableStream( p1 );
+
+    latencyAlarms.clear();
+    arrivalTime = base::Time::fromSeconds(10.3);
+    while( reader.step() );
+
+    // s1 lags by more than 0.5 seconds for the first 14 samples
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).samples_over_budget, 14 );
+    // all s2 samples stayed too long in the buffer
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s2 ).samples_over_budget, 20 );
+
+    // one alarm per second of data time and stream
+    BOOST_REQUIRE_EQUAL( latencyAlarms.size(), 4 );
+    BOOST_CHECK_EQUAL( latencyAlarms[0].stream, s1 );
+    BOOST_CHECK_CLOSE( latencyAlarms[0].lag.toSeconds(), 1.9, 1e-6 );
+    BOOST_CHECK_EQUAL( latencyAlarms[1].stream, s2 );
+    BOOST_CHECK_CLOSE( latencyAlarms[1].residence.toSeconds(), 0.3, 1e-6 );
+    BOOST_CHECK_EQUAL( latencyAlarms[2].stream, s1 );
+    BOOST_CHECK_EQUAL( latencyAlarms[2].violations, 10 );
+    BOOST_CHECK_EQUAL( latencyAlarms[3].stream, s2 );
+
+    reader.clear();
+    BOOST_CHECK_EQUAL( reader.getBufferStatus( s1 ).samples_over_budget, 0 );
+}
+
+struct position
+{
+    double x, y;
+};
+
+void extract_position( const position &p, double *row )
+{
+    row[0] = p.x;
+    row[1] = p.y;
+}
+
+void extract_int( const int &value, double *row )
+{
+    row[0] = value;
+}
+
+std::vector<ColumnarBatch> columnarBatches;
+void batch_callback( const ColumnarBatch &batch )
+{
+    columnarBatches.push_back( batch );
+}
+
+BOOST_AUTO_TEST_CASE( columnar_batch_test )
+{
+    columnarBatches.clear();
+    BOOST_CHECK_THROW( ColumnarBatchBuilder( 0, &batch_callback ), std::runtime_error );
+
+    ColumnarBatchBuilder builder( 4, &batch_callback );
+    std::vector<std::string> position_columns;
+    position_columns.push_back( "x" );
+    position_columns.push_back( "y" );
+    std::vector<std::string> count_columns( 1, "count" );
+
+    StreamAligner reader;
+    reader.setTimeout( base::Time::fromSeconds(2.0) );
+    int s1 = reader.registerStream<position>( builder.addStream<position>( "position", position_columns, &extract_position ),
+	    4, base::Time::fromSeconds(1) );
+    int s2 = reader.registerStream<int>( builder.addStream<int>( "count", count_columns, &extract_int ),
+	    4, base::Time::fromSeconds(1) );
+
+    // the columns can hold a full batch without reallocating
+    BOOST_CHECK( builder.getBatch().tables[0].times.capacity() >= 4u );
+    BOOST_CHECK( builder.getBatch().tables[0].columns[1].capacity() >= 4u );
+    BOOST_CHECK( builder.getBatch().tables[1].sequence.capacity() >= 4u );
+
+    for( int i = 0; i < 3; i++ )
+    {
+	position p = { double(i), double(-i) };
+	reader.push( s1, base::Time::fromSeconds(2.0 * i), p );
+	reader.push( s2, base::Time::fromSeconds(2.0 * i + 1), 10 * i );
+    }
+    reader.disableStream( s1 );
+    reader.disableStream( s2 );
+    while( reader.step() );
+
+    // 6 samples in batches of 4, the second one is only given on flush
+    BOOST_REQUIRE_EQUAL( columnarBatches.size(), 1u );
+    BOOST_CHECK_EQUAL( builder.getBatch().size(), 2u );
+    builder.flush();
+    builder.flush();
+    BOOST_REQUIRE_EQUAL( columnarBatches.size(), 2u );
+    BOOST_CHECK_EQUAL( builder.getSampleCount(), 6u );
+
+    const ColumnarBatch &first( columnarBatches[0] );
+    BOOST_CHECK_EQUAL( first.size(), 4u );
+    BOOST_REQUIRE_EQUAL( first.tables.size(), 2u );
+    const ColumnarBatch::Table &positions( first.tables[0] );
+    BOOST_CHECK_EQUAL( positions.name, "position" );
+    BOOST_CHECK_EQUAL( positions.column_names[1], "y" );
+    BOOST_REQUIRE_EQUAL( positions.size(), 2u );
+    BOOST_CHECK( positions.times[1] == base::Time::fromSeconds(2.0) );
+    BOOST_CHECK_EQUAL( positions.sequence[0], 0u );
+    BOOST_CHECK_EQUAL( positions.sequence[1], 2u );
+    BOOST_CHECK_EQUAL( positions.columns[0][1], 1.0 );
+    BOOST_CHECK_EQUAL( positions.columns[1][1], -1.0 );
+    const ColumnarBatch::Table &counts( first.tables[1] );
+    BOOST_REQUIRE_EQUAL( counts.size(), 2u );
+    BOOST_CHECK_EQUAL( counts.sequence[1], 3u );
+    BOOST_CHECK_EQUAL( counts.columns[0][1], 10.0 );
+
+    // the merge order continues across batches
+    const ColumnarBatch &second( columnarBatches[1] );
+    BOOST_REQUIRE_EQUAL( second.tables[0].size(), 1u );
+    BOOST_REQUIRE_EQUAL( second.tables[1].size(), 1u );
+    BOOST_CHECK_EQUAL( second.tables[0].sequence[0], 4u );
+    BOOST_CHECK_EQUAL( second.tables[1].sequence[0], 5u );
+    BOOST_CHECK( second.tables[1].times[0] == base::Time::fromSeconds(5.0) );
+    BOOST_CHECK_EQUAL( second.tables[1].columns[0][0], 20.0 );
+    BOOST_CHECK( builder.getBatch().empty() );
+}
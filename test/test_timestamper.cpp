@@ -5,12 +5,15 @@
 
 #include <iostream>
 #include <numeric>
+#include <limits.h>
 
 #include <boost/test/unit_test.hpp>
 #include <boost/test/execution_monitor.hpp>  
 
 #include <aggregator/TimestampEstimator.hpp>
 #include <fstream>
+#include <pthread.h>
+#include <sched.h>
 
 using namespace aggregator;
 
@@ -72,10 +75,11 @@ public:
     base::Time actualPeriod;
     
 public:
-    Tester(std::string debugFileName = "")
+    Tester(std::string debugFileName = "", long seed = 0)
     {
-	//init random nummer generator
-	srand48(time(NULL));
+	//init random nummer generator, seeded with the time unless the
+	//sequence has to be reproducible
+	srand48(seed ? seed : time(NULL));
 
 	baseTime = base::Time::now();
 	
@@ -140,7 +144,7 @@ enum LOSS_ANNOUNCE_METHODS
     USE_UPDATE_LOSS,
     USE_INDEX
 };
-void test_timestamper_impl(int hardware_order, bool has_initial_period, bool has_drift, int init, double loss_rate, LOSS_ANNOUNCE_METHODS loss_announce_method = USE_NONE)
+void test_timestamper_impl(int hardware_order, bool has_initial_period, bool has_drift, int init, double loss_rate, LOSS_ANNOUNCE_METHODS loss_announce_method = USE_NONE, double bucket_duration = 0, long seed = 0)
 {
     //this test case tries to emulate the values of an hokuyo laser scanner
     static const int COUNT = 10000;
@@ -159,9 +163,11 @@ void test_timestamper_impl(int hardware_order, bool has_initial_period, bool has
         csv_filename << "__init" << init;
     if (loss_rate)
         csv_filename << "__loss";
+    if (bucket_duration)
+        csv_filename << "__bucketed";
     csv_filename << ".csv";
 
-    Tester data(csv_filename.str());
+    Tester data(csv_filename.str(), seed);
     data.realPeriod = base::Time::fromSeconds(0.025);
     
     if (hardware_order != 0)
@@ -187,6 +193,8 @@ void test_timestamper_impl(int hardware_order, bool has_initial_period, bool has
     //estimator for testing
     TimestampEstimator estimator(base::Time::fromSeconds(20),
 	initial_period);
+    if (bucket_duration)
+        estimator.setWindowBucketDuration(base::Time::fromSeconds(bucket_duration));
     
     for (int i = 0; i < COUNT; ++i)
     {
@@ -220,6 +228,9 @@ void test_timestamper_impl(int hardware_order, bool has_initial_period, bool has
         else
             data.checkResult(estimatedTime, period);
     }
+
+    if (bucket_duration)
+        BOOST_CHECK(estimator.getStatus().window_capacity < 20 / bucket_duration + 40);
 }
 
 BOOST_AUTO_TEST_CASE(test_timestamper__plain)
@@ -272,6 +283,27 @@ BOOST_AUTO_TEST_CASE(test_timestamper__initial_period__loss_index)
 { test_timestamper_impl(0, true, false, 0, 0.01, USE_INDEX); }
 BOOST_AUTO_TEST_CASE(test_timestamper__loss_index)
 { test_timestamper_impl(0, false, false, 1000, 0.01, USE_INDEX); }
+BOOST_AUTO_TEST_CASE(test_timestamper__bucketed)
+{ test_timestamper_impl(0, false, false, 1000, 0, USE_NONE, 0.25); }
+BOOST_AUTO_TEST_CASE(test_timestamper__initial_period__bucketed)
+{ test_timestamper_impl(0, true, false, 0, 0, USE_NONE, 0.25); }
+BOOST_AUTO_TEST_CASE(test_timestamper__hw_after__bucketed)
+{ test_timestamper_impl(1, false, false, 1000, 0, USE_NONE, 0.25); }
+BOOST_AUTO_TEST_CASE(test_timestamper__loss_index__bucketed)
+{ test_timestamper_impl(0, false, false, 1000, 0.01, USE_INDEX, 0.25); }
+BOOST_AUTO_TEST_CASE(test_timestamper__loss_updateLoss__bucketed)
+{ test_timestamper_impl(0, false, false, 1000, 0.01, USE_UPDATE_LOSS, 0.25); }
+
+// Sequences for which the period fitted on the buckets used to be off. With
+// seed 126, the least-latency samples of the first buckets were neighbours,
+// with seed 114 two buckets with a high jitter were used for the whole window
+BOOST_AUTO_TEST_CASE(test_timestamper__bucketed__seed126)
+{ test_timestamper_impl(0, false, false, 1000, 0, USE_NONE, 0.25, 126); }
+BOOST_AUTO_TEST_CASE(test_timestamper__loss_index__bucketed__seed126)
+{ test_timestamper_impl(0, false, false, 1000, 0.01, USE_INDEX, 0.25, 126); }
+BOOST_AUTO_TEST_CASE(test_timestamper__initial_period__bucketed__seed114)
+{ test_timestamper_impl(0, true, false, 0, 0, USE_NONE, 0.25, 114); }
+
 // BOOST_AUTO_TEST_CASE(test_timestamper__hw_before__initial_period__drift__loss)
 // { test_timestamper_impl(-1, true, true, 0, 0.01); }
 // BOOST_AUTO_TEST_CASE(test_timestamper__hw_before__drift__loss)
@@ -285,3 +317,166 @@ BOOST_AUTO_TEST_CASE(test_timestamper__loss_index)
 // BOOST_AUTO_TEST_CASE(test_timestamper__drift__loss)
 // { test_timestamper_impl(0, false, true, 1000, 0.01); }
 
+
+BOOST_AUTO_TEST_CASE(test_timestamper__index_wraparound_and_reset)
+{
+    base::Time time = base::Time::now();
+    base::Time step = base::Time::fromSeconds(0.01);
+
+    TimestampEstimator estimator(base::Time::fromSeconds(2), step);
+    estimator.setIndexWidth(32);
+
+    // a 32 bit counter wrapping around is not a loss
+    int64_t index = 0xFFFFFFFFLL - 100;
+    for (int i = 0; i < 400; ++i)
+    {
+        time = time + step;
+        estimator.update(time, index);
+        index = (index + 1) & 0xFFFFFFFFLL;
+    }
+    BOOST_REQUIRE_EQUAL(0, estimator.getStatus().expected_losses);
+    BOOST_REQUIRE_EQUAL(0, estimator.getStatus().rejected_expected_losses);
+    BOOST_REQUIRE_EQUAL(0, estimator.getIndexResetCount());
+
+    // a genuine loss of a few samples is still accounted for
+    int lost_before = estimator.getStatus().lost_samples_total;
+    time = time + step * 4;
+    index = (index + 3) & 0xFFFFFFFFLL;
+    estimator.update(time, index);
+    TimestampEstimatorStatus status = estimator.getStatus();
+    BOOST_REQUIRE_EQUAL(3, status.lost_samples_total - lost_before + status.expected_losses);
+
+    // an index jump much larger than the elapsed time allows is a
+    // reset of the counter, not a loss
+    time = time + step;
+    estimator.update(time, (index + 1000000000LL) & 0xFFFFFFFFLL);
+    BOOST_REQUIRE_EQUAL(1, estimator.getIndexResetCount());
+    BOOST_REQUIRE_EQUAL(1, estimator.getStatus().index_resets);
+    BOOST_REQUIRE_EQUAL(status.expected_losses, estimator.getStatus().expected_losses);
+
+    // and so is an index going backwards
+    time = time + step;
+    estimator.update(time, 0);
+    BOOST_REQUIRE_EQUAL(2, estimator.getIndexResetCount());
+}
+
+BOOST_AUTO_TEST_CASE(test_timestamper__huge_index_jump_saturates)
+{
+    base::Time time = base::Time::now();
+    base::Time step = base::Time::fromSeconds(0.01);
+
+    // without an estimate, huge jumps are taken as losses and must not
+    // loop over the lost samples nor overflow the counter
+    TimestampEstimator estimator(base::Time::fromSeconds(2), 0);
+    estimator.update(time, 0);
+    estimator.update(time + step, 1LL << 62);
+    BOOST_REQUIRE_EQUAL(INT_MAX, estimator.getStatus().expected_losses);
+
+    estimator.updateLoss(INT_MAX);
+    BOOST_REQUIRE_EQUAL(INT_MAX, estimator.getStatus().expected_losses);
+}
+
+BOOST_AUTO_TEST_CASE(test_timestamper__status_snapshot)
+{
+    base::Time time = base::Time::now();
+    base::Time step = base::Time::fromSeconds(0.01);
+
+    // the status is available even before a period can be estimated
+    TimestampEstimator estimator(base::Time::fromSeconds(2), 0);
+    BOOST_REQUIRE_NO_THROW(estimator.getStatus());
+    BOOST_CHECK(estimator.getStatus().period == base::Time());
+    estimator.enableStatusSnapshot();
+    BOOST_CHECK(estimator.getStatusSnapshot().period == base::Time());
+
+    // nothing is published until the snapshot is enabled
+    TimestampEstimator with_period(base::Time::fromSeconds(2), step);
+    with_period.update(time);
+    BOOST_CHECK(with_period.getStatusSnapshot().time_raw == base::Time());
+    with_period.enableStatusSnapshot();
+    BOOST_CHECK(with_period.getStatusSnapshot().period == step);
+    BOOST_CHECK(with_period.getStatusSnapshot().time_raw == time);
+
+    // the snapshot follows the calls to update()
+    for (int i = 0; i < 500; ++i)
+    {
+        time = time + step;
+        base::Time estimate = estimator.update(time);
+        TimestampEstimatorStatus snapshot = estimator.getStatusSnapshot();
+        TimestampEstimatorStatus status = estimator.getStatus();
+        BOOST_REQUIRE(snapshot.stamp == estimate);
+        BOOST_REQUIRE(snapshot.period == status.period);
+        BOOST_REQUIRE(snapshot.time_raw == time);
+        BOOST_REQUIRE_EQUAL(status.window_size, snapshot.window_size);
+    }
+    BOOST_CHECK_CLOSE(step.toSeconds(), estimator.getStatusSnapshot().period.toSeconds(), 1e-3);
+
+    estimator.reset();
+    BOOST_CHECK_EQUAL(0, estimator.getStatusSnapshot().window_size);
+
+    // once disabled, the snapshot keeps the last published status
+    estimator.disableStatusSnapshot();
+    estimator.update(time + step);
+    BOOST_CHECK_EQUAL(0, estimator.getStatusSnapshot().window_size);
+}
+
+struct SnapshotReader
+{
+    const TimestampEstimator* estimator;
+    base::Time start;
+    base::Time step;
+    volatile bool done;
+    volatile int reads;
+    int errors;
+
+    SnapshotReader(const TimestampEstimator& estimator, base::Time start, base::Time step)
+        : estimator(&estimator), start(start), step(step), done(false), reads(0), errors(0) {}
+
+    static void* run(void* arg)
+    {
+        SnapshotReader& reader = *static_cast<SnapshotReader*>(arg);
+        while (!reader.done)
+        {
+            reader.check(reader.estimator->getStatusSnapshot());
+            ++reader.reads;
+        }
+        return 0;
+    }
+
+    void check(TimestampEstimatorStatus const& status)
+    {
+        // on a perfect stream, the estimate is the sample time and the
+        // window holds one sample per update since the reset. A status
+        // mixing two updates breaks either relation
+        if (status.window_size == 0)
+            return;
+        if (status.stamp != status.time_raw
+                || status.time_raw - start != step * (status.window_size - 1)
+                || status.lost_samples_total != 0)
+            ++errors;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(test_timestamper__status_snapshot_threads)
+{
+    base::Time start = base::Time::fromSeconds(1000);
+    base::Time step = base::Time::fromMilliseconds(10);
+
+    // the window is large enough to never drop samples
+    TimestampEstimator estimator(base::Time::fromSeconds(1000), step);
+    estimator.enableStatusSnapshot();
+
+    SnapshotReader reader(estimator, start, step);
+    pthread_t thread;
+    BOOST_REQUIRE_EQUAL(0, pthread_create(&thread, 0, &SnapshotReader::run, &reader));
+    while (reader.reads == 0)
+        sched_yield();
+    for (int i = 0; i < 20000; ++i)
+        estimator.update(start + step * i);
+    reader.done = true;
+    pthread_join(thread, 0);
+
+    reader.check(estimator.getStatusSnapshot());
+    BOOST_CHECK_EQUAL(0, reader.errors);
+    BOOST_CHECK(reader.reads > 0);
+    BOOST_CHECK_EQUAL(20000, estimator.getStatusSnapshot().window_size);
+}